@@ -0,0 +1,84 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file BenchPlugin.cpp
+ * \brief The synthetic plugin used by the benchmarks.
+ *
+ */
+
+#include "BenchPlugin.h"
+
+#include <dlfcn.h>
+
+namespace lib_manager {
+
+    /**
+     * Returns the name of the file this code was loaded from, without the
+     * directory, the "lib" prefix and the suffix.
+     */
+    static std::string nameFromFile()
+    {
+        Dl_info info;
+        static const char anchor = 0;
+        if(!dladdr(&anchor, &info) || !info.dli_fname) {
+            return "bench";
+        }
+        std::string name = info.dli_fname;
+        size_t pos = name.find_last_of('/');
+        if(pos != std::string::npos) {
+            name.erase(0, pos + 1);
+        }
+        if(name.compare(0, 3, "lib") == 0) {
+            name.erase(0, 3);
+        }
+        pos = name.find('.');
+        if(pos != std::string::npos) {
+            name.erase(pos);
+        }
+        return name;
+    }
+
+    class BenchPlugin : public BenchInterface {
+    public:
+        BenchPlugin(LibManager *theManager)
+            : BenchInterface(theManager), name(nameFromFile()), loadedCount(0)
+        {}
+
+        int getLibVersion() const
+        { return 1; }
+        const std::string getLibName() const
+        { return name; }
+        void newLibLoaded(const std::string &)
+        { ++loadedCount; }
+        unsigned int getLoadedCount() const
+        { return loadedCount; }
+
+        CREATE_MODULE_INFO();
+
+    private:
+        std::string name;
+        unsigned int loadedCount;
+    };
+
+} // end of namespace lib_manager
+
+DESTROY_LIB(lib_manager::BenchPlugin);
+CREATE_LIB(lib_manager::BenchPlugin);
@@ -0,0 +1,49 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file BenchPlugin.h
+ * \brief Interface of the synthetic plugin used by the benchmarks.
+ *
+ */
+
+#ifndef LIB_MANAGER_BENCH_PLUGIN_H
+#define LIB_MANAGER_BENCH_PLUGIN_H
+
+#include "LibInterface.h"
+
+namespace lib_manager {
+
+    /**
+     * The benchmark copies one plugin library to many files. Every copy
+     * calls itself like its file, e.g. libbench_7.so registers as
+     * "bench_7".
+     */
+    class BenchInterface : public LibInterface {
+    public:
+        BenchInterface(LibManager *theManager) : LibInterface(theManager) {}
+
+        /// Number of newLibLoaded() calls this instance received.
+        virtual unsigned int getLoadedCount() const = 0;
+    };
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_BENCH_PLUGIN_H */
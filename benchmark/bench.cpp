@@ -0,0 +1,207 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file bench.cpp
+ * \brief Measures the load, lookup and teardown paths of the LibManager.
+ *
+ * For every library count N (10, 100 and 1000 unless given on the command
+ * line) the plugin library is copied to N files in a temporary directory,
+ * which are then loaded through a config file.
+ */
+
+#include "BenchPlugin.h"
+#include "LibManager.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+using namespace lib_manager;
+using namespace std;
+
+static const int acquireRounds = 100000;
+
+static double now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool copyFile(const string &from, const string &to)
+{
+    ifstream in(from.c_str(), ios::binary);
+    ofstream out(to.c_str(), ios::binary);
+    out << in.rdbuf();
+    return in && out;
+}
+
+static void report(size_t n, const char *what, double seconds, double ops)
+{
+    if(ops > 0) {
+        printf("%6zu  %-32s %12.3f ms %10.1f ns/op\n", n, what,
+               seconds * 1e3, seconds * 1e9 / ops);
+    } else {
+        printf("%6zu  %-32s %12.3f ms\n", n, what, seconds * 1e3);
+    }
+}
+
+/**
+ * Acquires and releases the libraries round robin in numThreads threads.
+ * Returns the wall time.
+ */
+static double acquireRelease(LibManager *manager, const vector<string> &names,
+                             unsigned int numThreads, bool cast)
+{
+    atomic<bool> go(false);
+    vector<thread> threads;
+    for(unsigned int t = 0; t < numThreads; ++t) {
+        threads.push_back(thread([&, t]() {
+            while(!go) {
+                this_thread::yield();
+            }
+            for(int i = 0; i < acquireRounds; ++i) {
+                const string &name = names[(i + t) % names.size()];
+                LibInterface *lib;
+                if(cast) {
+                    lib = manager->acquireLibraryAs<BenchInterface>(name);
+                } else {
+                    lib = manager->acquireLibrary(name);
+                }
+                if(lib) {
+                    manager->releaseLibrary(name);
+                }
+            }
+        }));
+    }
+    double start = now();
+    go = true;
+    for(size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    return now() - start;
+}
+
+/**
+ * Drops the references loadLibrary() left on the libraries, which unloads
+ * them, and lets clearLibraries() collect whatever remains.
+ */
+static double teardown(LibManager *manager, const vector<string> &names)
+{
+    double start = now();
+    for(size_t i = 0; i < names.size(); ++i) {
+        manager->releaseLibrary(names[i]);
+    }
+    manager->clearLibraries();
+    return now() - start;
+}
+
+static void run(const string &plugin, size_t n)
+{
+    char dirTemplate[] = "/tmp/lib_manager_bench.XXXXXX";
+    if(!mkdtemp(dirTemplate)) {
+        perror("mkdtemp");
+        return;
+    }
+    const string dir = dirTemplate;
+    vector<string> files, names;
+    const string config = dir + "/plugins.txt";
+    ofstream configFile(config.c_str());
+    for(size_t i = 0; i <= n; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "bench_%zu", i);
+        files.push_back(dir + "/lib" + name + ".so");
+        if(!copyFile(plugin, files.back())) {
+            fprintf(stderr, "cannot copy %s\n", plugin.c_str());
+            n = i;
+            break;
+        }
+        // the last copy is loaded separately to measure the fan-out
+        if(i < n) {
+            names.push_back(name);
+            configFile << files.back() << "\n";
+        }
+    }
+    configFile.close();
+
+    {
+        LibManager manager;
+        manager.setLogLevel(LibManager::LIBMGR_LOG_WARNING);
+
+        double start = now();
+        manager.loadConfigFile(config);
+        report(n, "loadConfigFile (cold)", now() - start, n);
+
+        report(n, "teardown", teardown(&manager, names), n);
+
+        start = now();
+        manager.loadConfigFile(config);
+        report(n, "loadConfigFile (warm)", now() - start, n);
+
+        const string extra = "bench_" + to_string(n);
+        start = now();
+        manager.loadLibrary(files[n]);
+        report(n, "addLibrary", now() - start, 0);
+        LibStats stats = manager.getLibraryStats(extra);
+        report(n, "  newLibLoaded fan-out", stats.notifyTime * 1e-9, n);
+        manager.releaseLibrary(extra);
+
+        double seconds = acquireRelease(&manager, names, 1, false);
+        report(n, "acquire/release (1 thread)", seconds, acquireRounds);
+        unsigned int numThreads = max(2u, thread::hardware_concurrency());
+        seconds = acquireRelease(&manager, names, numThreads, false);
+        char what[64];
+        snprintf(what, sizeof(what), "acquire/release (%u threads)",
+                 numThreads);
+        report(n, what, seconds, (double)acquireRounds * numThreads);
+        seconds = acquireRelease(&manager, names, 1, true);
+        report(n, "acquireLibraryAs/release", seconds, acquireRounds);
+
+        report(n, "teardown", teardown(&manager, names), n);
+    }
+
+    for(size_t i = 0; i < files.size(); ++i) {
+        unlink(files[i].c_str());
+    }
+    unlink(config.c_str());
+    rmdir(dir.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    vector<size_t> counts;
+    for(int i = 1; i < argc; ++i) {
+        counts.push_back(strtoul(argv[i], NULL, 10));
+    }
+    if(counts.empty()) {
+        counts.push_back(10);
+        counts.push_back(100);
+        counts.push_back(1000);
+    }
+    for(size_t i = 0; i < counts.size(); ++i) {
+        if(counts[i] > 0) {
+            run(LIB_MANAGER_BENCH_PLUGIN, counts[i]);
+        }
+    }
+    return 0;
+}
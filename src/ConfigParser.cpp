@@ -0,0 +1,275 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file ConfigParser.cpp
+ * \brief "ConfigParser" reads the plugin lists of LibManager::loadConfigFile().
+ *
+ */
+
+#include "ConfigParser.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace lib_manager {
+
+using namespace std;
+
+static const char *whitespace = " \t\r";
+
+/**
+ * Reads the whole file into content. Returns false if it cannot be read.
+ */
+static bool readFile(const string &filename, string *content)
+{
+    FILE *file = fopen(filename.c_str(), "rb");
+    if(!file) {
+        return false;
+    }
+    bool ok = (fseek(file, 0, SEEK_END) == 0);
+    long size = ok ? ftell(file) : -1;
+    ok = ok && size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+    if(ok && size > 0) {
+        content->resize(size);
+        ok = (fread(&(*content)[0], 1, size, file) == (size_t)size);
+    }
+    fclose(file);
+    return ok;
+}
+
+/**
+ * Returns the absolute path of an existing file without . and .. parts and
+ * symbolic links, so that include cycles are recognized.
+ */
+static string canonicalPath(const string &filename)
+{
+#ifdef WIN32
+    char *path = _fullpath(NULL, filename.c_str(), 0);
+#else
+    char *path = realpath(filename.c_str(), NULL);
+#endif
+    if(!path) {
+        return filename;
+    }
+    string result = path;
+    free(path);
+    return result;
+}
+
+/**
+ * Removes the next whitespace separated token from text and returns it. A
+ * token in double quotes can contain whitespace.
+ */
+static string_view nextToken(string_view *text)
+{
+    size_t start = text->find_first_not_of(whitespace);
+    if(start == string_view::npos) {
+        *text = string_view();
+        return string_view();
+    }
+    size_t end;
+    string_view token;
+    if((*text)[start] == '"') {
+        end = text->find('"', start + 1);
+        token = text->substr(start + 1, end == string_view::npos ?
+                             string_view::npos : end - start - 1);
+        if(end != string_view::npos) {
+            ++end;
+        }
+    } else {
+        end = text->find_first_of(whitespace, start);
+        token = text->substr(start, end == string_view::npos ?
+                             string_view::npos : end - start);
+    }
+    *text = end == string_view::npos ? string_view() : text->substr(end);
+    return token;
+}
+
+ConfigParser::ConfigParser(Logger *logger) : logger(logger) {
+}
+
+bool ConfigParser::parse(const string &filename, int defaultFlags,
+                         vector<ConfigEntry> *entries)
+{
+    string content;
+    if(!readFile(filename, &content)) {
+        LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_ERROR,
+                   "LibManager::loadConfigFile: file \"%s\" not found.",
+                   filename.c_str());
+        return false;
+    }
+
+    openFiles.push_back(canonicalPath(filename));
+    string_view text = content;
+    unsigned int lineNumber = 0;
+    while(!text.empty()) {
+        size_t end = text.find('\n');
+        parseLine(text.substr(0, end), filename, ++lineNumber, defaultFlags,
+                  entries);
+        text = (end == string_view::npos ? string_view() :
+                text.substr(end + 1));
+    }
+    openFiles.pop_back();
+    return true;
+}
+
+void ConfigParser::parseLine(string_view line, const string &filename,
+                             unsigned int lineNumber, int defaultFlags,
+                             vector<ConfigEntry> *entries)
+{
+    size_t start = line.find_first_not_of(whitespace);
+    if(start == string_view::npos || line[start] == '#') {
+        return;
+    }
+    string_view rest = line;
+    string_view path = nextToken(&rest);
+
+    if(path == "include") {
+        // like a library path, the file name can contain whitespace
+        size_t first = rest.find_first_not_of(whitespace);
+        string included;
+        if(first != string_view::npos && rest[first] == '"') {
+            included = nextToken(&rest);
+        } else if(first != string_view::npos) {
+            included = rest.substr(first, rest.find_last_not_of(whitespace) -
+                                   first + 1);
+        }
+        if(included.empty()) {
+            LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_WARNING,
+                       "LibManager::loadConfigFile: %s:%u: include without "
+                       "a file.", filename.c_str(), lineNumber);
+            return;
+        }
+        // relative includes are relative to the including file
+        size_t slash = filename.find_last_of("/\\");
+        bool absolute = (included[0] == '/' || included[0] == '\\' ||
+                         (included.size() > 1 && included[1] == ':'));
+        if(!absolute && slash != string::npos) {
+            included.insert(0, filename, 0, slash + 1);
+        }
+        if(find(openFiles.begin(), openFiles.end(), canonicalPath(included)) !=
+           openFiles.end()) {
+            LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_WARNING,
+                       "LibManager::loadConfigFile: %s:%u: \"%s\" includes "
+                       "itself.", filename.c_str(), lineNumber,
+                       included.c_str());
+            return;
+        }
+        parse(included, defaultFlags, entries);
+        return;
+    }
+
+    ConfigEntry entry;
+    entry.flags = defaultFlags;
+    if(line[start] == '"') {
+        entry.libPath = path;
+        for(string_view option = nextToken(&rest); !option.empty();
+            option = nextToken(&rest)) {
+            if(!parseOption(option, &entry)) {
+                LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_WARNING,
+                           "LibManager::loadConfigFile: %s:%u: bad load "
+                           "option \"%.*s\" for \"%s\".", filename.c_str(),
+                           lineNumber, (int)option.size(), option.data(),
+                           entry.libPath.c_str());
+            }
+        }
+        entries->push_back(entry);
+        return;
+    }
+
+    // Without quotes only the known options at the end of the line are
+    // options; the rest is the path, which may contain whitespace as it
+    // could before options existed.
+    string_view body = line.substr(start, line.find_last_not_of(whitespace) -
+                                   start + 1);
+    vector<string_view> options;
+    for(;;) {
+        size_t space = body.find_last_of(whitespace);
+        if(space == string_view::npos) {
+            break;
+        }
+        string_view option = body.substr(space + 1);
+        ConfigEntry scratch;
+        if(!parseOption(option, &scratch)) {
+            break;
+        }
+        options.push_back(option);
+        body = body.substr(0, body.find_last_not_of(whitespace, space) + 1);
+    }
+    entry.libPath = body;
+    for(size_t i = options.size(); i-- > 0; ) {
+        parseOption(options[i], &entry);
+    }
+    entries->push_back(entry);
+}
+
+/**
+ * Applies one option of a library line to entry. Returns false if the
+ * option is unknown or malformed.
+ */
+bool ConfigParser::parseOption(string_view option, ConfigEntry *entry) const
+{
+    if(option == "lazy") {
+        entry->flags |= LibManager::LIBMGR_LOAD_LAZY;
+    } else if(option == "eager") {
+        entry->flags &= ~LibManager::LIBMGR_LOAD_LAZY;
+    } else if(option == "now") {
+        entry->flags |= LibManager::LIBMGR_LOAD_NOW;
+    } else if(option == "bindlazy") {
+        entry->flags &= ~LibManager::LIBMGR_LOAD_NOW;
+    } else if(option == "global") {
+        entry->flags |= LibManager::LIBMGR_LOAD_GLOBAL;
+    } else if(option == "local") {
+        entry->flags &= ~LibManager::LIBMGR_LOAD_GLOBAL;
+    } else if(option == "nodelete") {
+        entry->flags |= LibManager::LIBMGR_LOAD_NODELETE;
+    } else if(option == "deepbind") {
+        entry->flags |= LibManager::LIBMGR_LOAD_DEEPBIND;
+    } else if(option == "locked") {
+        entry->flags |= LibManager::LIBMGR_LOAD_LOCKED;
+    } else if(option.compare(0, 9, "priority=") == 0) {
+        string value(option.substr(9));
+        char *end;
+        long priority = strtol(value.c_str(), &end, 10);
+        if(value.empty() || *end) {
+            return false;
+        }
+        entry->priority = (int)priority;
+    } else if(option.compare(0, 8, "depends=") == 0) {
+        string_view names = option.substr(8);
+        while(!names.empty()) {
+            size_t comma = names.find(',');
+            string_view name = names.substr(0, comma);
+            if(!name.empty()) {
+                entry->dependencies.push_back(string(name));
+            }
+            names = (comma == string_view::npos ? string_view() :
+                     names.substr(comma + 1));
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // end of namespace lib_manager
@@ -0,0 +1,86 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file ConfigParser.h
+ * \brief "ConfigParser" reads the plugin lists of LibManager::loadConfigFile().
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_CONFIG_PARSER_H
+#define LIB_MANAGER_CONFIG_PARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lib_manager {
+
+    class Logger;
+
+    /// One library line of a config file.
+    struct ConfigEntry {
+        ConfigEntry() : flags(0), priority(0) {}
+
+        /// The path or name to load.
+        std::string libPath;
+        /// LoadFlags, starting from the defaults given to parse().
+        int flags;
+        /// Higher priorities are loaded first within a dependency level.
+        int priority;
+        /// Names or paths of other entries that must be loaded first.
+        std::vector<std::string> dependencies;
+    };
+
+    /**
+     * Parses config files into the list of libraries to load. Every file
+     * is read with a single read and split in place, so lines can have
+     * any length. See LibManager::loadConfigFile() for the syntax.
+     */
+    class ConfigParser {
+    public:
+        explicit ConfigParser(Logger *logger);
+        ConfigParser(const ConfigParser &) = delete;
+        ConfigParser& operator=(const ConfigParser &) = delete;
+
+        /**
+         * Appends the entries of filename and of the files it includes to
+         * entries. Returns false if filename cannot be read; problems in
+         * included files are only logged.
+         */
+        bool parse(const std::string &filename, int defaultFlags,
+                   std::vector<ConfigEntry> *entries);
+
+    private:
+        Logger *logger;
+        /// The files currently being parsed, to detect include cycles.
+        std::vector<std::string> openFiles;
+
+        void parseLine(std::string_view line, const std::string &filename,
+                       unsigned int lineNumber, int defaultFlags,
+                       std::vector<ConfigEntry> *entries);
+        bool parseOption(std::string_view option, ConfigEntry *entry) const;
+    }; // class ConfigParser
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_CONFIG_PARSER_H */
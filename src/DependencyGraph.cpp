@@ -0,0 +1,116 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file DependencyGraph.cpp
+ * \brief Sorts libraries by their dependencies.
+ *
+ */
+
+#include "DependencyGraph.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace lib_manager {
+
+using namespace std;
+
+bool sortIntoLevels(const vector<vector<size_t> > &dependencies,
+                    vector<vector<size_t> > *levels)
+{
+    const size_t n = dependencies.size();
+    vector<size_t> missing(n, 0);
+    vector<vector<size_t> > dependents(n);
+    for(size_t i = 0; i < n; ++i) {
+        for(size_t d = 0; d < dependencies[i].size(); ++d) {
+            size_t dep = dependencies[i][d];
+            if(dep < n && dep != i) {
+                missing[i]++;
+                dependents[dep].push_back(i);
+            }
+        }
+    }
+
+    // Kahn's algorithm, one level at a time
+    vector<size_t> current;
+    for(size_t i = 0; i < n; ++i) {
+        if(missing[i] == 0) {
+            current.push_back(i);
+        }
+    }
+    size_t sorted = 0;
+    vector<bool> done(n, false);
+    while(!current.empty()) {
+        sorted += current.size();
+        vector<size_t> next;
+        for(size_t c = 0; c < current.size(); ++c) {
+            size_t node = current[c];
+            done[node] = true;
+            for(size_t d = 0; d < dependents[node].size(); ++d) {
+                size_t dependent = dependents[node][d];
+                if(--missing[dependent] == 0) {
+                    next.push_back(dependent);
+                }
+            }
+        }
+        levels->push_back(current);
+        // keep the input order within a level
+        sort(next.begin(), next.end());
+        current.swap(next);
+    }
+
+    if(sorted == n) {
+        return true;
+    }
+    vector<size_t> rest;
+    for(size_t i = 0; i < n; ++i) {
+        if(!done[i]) {
+            rest.push_back(i);
+        }
+    }
+    levels->push_back(rest);
+    return false;
+}
+
+bool sortIntoLevels(const vector<string> &names,
+                    const vector<vector<string> > &dependencies,
+                    vector<vector<size_t> > *levels)
+{
+    unordered_map<string, size_t> nodes;
+    for(size_t i = 0; i < names.size(); ++i) {
+        if(!names[i].empty()) {
+            nodes.insert(make_pair(names[i], i));
+        }
+    }
+    vector<vector<size_t> > edges(names.size());
+    for(size_t i = 0; i < names.size() && i < dependencies.size(); ++i) {
+        for(size_t d = 0; d < dependencies[i].size(); ++d) {
+            unordered_map<string, size_t>::const_iterator it;
+            it = nodes.find(dependencies[i][d]);
+            if(it != nodes.end()) {
+                edges[i].push_back(it->second);
+            }
+        }
+    }
+    return sortIntoLevels(edges, levels);
+}
+
+} // end of namespace lib_manager
@@ -0,0 +1,62 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file DependencyGraph.h
+ * \brief Sorts libraries by their dependencies.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_DEPENDENCY_GRAPH_H
+#define LIB_MANAGER_DEPENDENCY_GRAPH_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace lib_manager {
+
+    /**
+     * Sorts the nodes 0..n-1 into levels such that every node is in a later
+     * level than all nodes it depends on. Nodes within one level do not
+     * depend on each other and keep their relative order.
+     *
+     * @param dependencies For every node the nodes it depends on.
+     * @param levels Receives the levels.
+     * @return false if there were cycles. The nodes on or behind a cycle are
+     *         then appended as one last level in index order.
+     */
+    bool sortIntoLevels(const std::vector<std::vector<size_t> > &dependencies,
+                        std::vector<std::vector<size_t> > *levels);
+
+    /**
+     * Same as sortIntoLevels(), but the graph is given by library names:
+     * node i is called names[i] and depends on the libraries in
+     * dependencies[i]. Names that are not in names are ignored.
+     */
+    bool sortIntoLevels(const std::vector<std::string> &names,
+                        const std::vector<std::vector<std::string> > &dependencies,
+                        std::vector<std::vector<size_t> > *levels);
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_DEPENDENCY_GRAPH_H */
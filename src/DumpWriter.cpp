@@ -0,0 +1,433 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file DumpWriter.cpp
+ * \brief "DumpWriter" serializes the module list of LibManager::dumpTo().
+ *
+ * Binary layout (native byte order, checked through byteOrder):
+ *   char magic[8]            "LMDUMP\0\0"
+ *   uint32_t byteOrder       0x01020304
+ *   uint32_t formatVersion   1
+ *   uint32_t numModules
+ *   numModules times:
+ *     int32_t version
+ *     uint32_t nameLen, srcLen, revisionLen
+ *     char name[nameLen], src[srcLen], revision[revisionLen]
+ *
+ * followed, only while reference tracking is on, by:
+ *   char magic[8]            "LMTELEM\0"
+ *   uint32_t numLibs
+ *   numLibs times:
+ *     uint32_t nameLen, char name[nameLen]
+ *     int32_t references
+ *     uint64_t lockWait[40], holdTime[40], acquireRate[40], releaseRate[40]
+ *     uint32_t numHolders
+ *     numHolders times:
+ *       uint64_t age
+ *       uint32_t tagLen, char tag[tagLen]
+ *       uint32_t numFrames, uint64_t frames[numFrames]
+ */
+
+#include "DumpWriter.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+namespace lib_manager {
+
+using namespace std;
+
+static const char dumpMagic[8] = { 'L', 'M', 'D', 'U', 'M', 'P', '\0', '\0' };
+static const uint32_t dumpByteOrder = 0x01020304;
+static const uint32_t dumpFormatVersion = 1;
+static const char telemetryMagic[8] = { 'L', 'M', 'T', 'E', 'L', 'E', 'M', '\0' };
+
+DumpWriter::DumpWriter(LibManager::DumpFormat format, FILE *file)
+    : format(format), file(file), fd(-1), buffer(NULL), ok(file != NULL),
+      first(true), inTelemetry(false), used(0) {
+}
+
+DumpWriter::DumpWriter(LibManager::DumpFormat format, int fd)
+    : format(format), file(NULL), fd(fd), buffer(NULL), ok(fd >= 0),
+      first(true), inTelemetry(false), used(0) {
+}
+
+DumpWriter::DumpWriter(LibManager::DumpFormat format, string *buffer)
+    : format(format), file(NULL), fd(-1), buffer(buffer), ok(buffer != NULL),
+      first(true), inTelemetry(false), used(0) {
+}
+
+void DumpWriter::begin(uint32_t numModules)
+{
+    switch(format) {
+    case LibManager::LIBMGR_DUMP_XML:
+        put("  <modules>\n");
+        break;
+    case LibManager::LIBMGR_DUMP_JSON:
+        put("{\"modules\": [");
+        break;
+    case LibManager::LIBMGR_DUMP_BINARY:
+        put(dumpMagic, sizeof(dumpMagic));
+        putUint32(dumpByteOrder);
+        putUint32(dumpFormatVersion);
+        putUint32(numModules);
+        break;
+    }
+}
+
+void DumpWriter::module(string_view name, string_view src, int version,
+                        string_view revision, bool withVersion)
+{
+    switch(format) {
+    case LibManager::LIBMGR_DUMP_XML:
+        put("    <module>\n      <name>");
+        putXml(name);
+        put("</name>\n      <src>");
+        putXml(src);
+        if(withVersion) {
+            put("</src>\n      <version>");
+            putInt(version);
+            put("</version>\n      <revision>");
+        } else {
+            put("</src>\n      <revision>");
+        }
+        putXml(revision);
+        put("</revision>\n    </module>\n");
+        break;
+    case LibManager::LIBMGR_DUMP_JSON:
+        put(first ? "\n  {\"name\": \"" : ",\n  {\"name\": \"");
+        putJson(name);
+        put("\", \"src\": \"");
+        putJson(src);
+        put("\", \"version\": ");
+        putInt(version);
+        put(", \"revision\": \"");
+        putJson(revision);
+        put("\"}");
+        break;
+    case LibManager::LIBMGR_DUMP_BINARY: {
+        int32_t v = version;
+        put(reinterpret_cast<const char*>(&v), sizeof(v));
+        putUint32(name.size());
+        putUint32(src.size());
+        putUint32(revision.size());
+        put(name);
+        put(src);
+        put(revision);
+        break;
+    }
+    }
+    first = false;
+}
+
+void DumpWriter::beginTelemetry(uint32_t numLibs)
+{
+    switch(format) {
+    case LibManager::LIBMGR_DUMP_XML:
+        put("  </modules>\n  <telemetry>\n");
+        break;
+    case LibManager::LIBMGR_DUMP_JSON:
+        put("\n], \"telemetry\": [");
+        break;
+    case LibManager::LIBMGR_DUMP_BINARY:
+        put(telemetryMagic, sizeof(telemetryMagic));
+        putUint32(numLibs);
+        break;
+    }
+    first = true;
+    inTelemetry = true;
+}
+
+/**
+ * Histograms are written sparsely as bucket:count pairs in XML and as
+ * [bucket, count] pairs in JSON; the binary format has all buckets.
+ */
+void DumpWriter::telemetry(string_view name, int references,
+                           const LibTelemetry &telemetry)
+{
+    const vector<RefHolder> &holders = telemetry.holders;
+    switch(format) {
+    case LibManager::LIBMGR_DUMP_XML:
+        put("    <library>\n      <name>");
+        putXml(name);
+        put("</name>\n      <references>");
+        putInt(references);
+        put("</references>\n");
+        putHistogram("lockWait", telemetry.lockWait);
+        putHistogram("holdTime", telemetry.holdTime);
+        putHistogram("acquireRate", telemetry.acquireRate);
+        putHistogram("releaseRate", telemetry.releaseRate);
+        for(size_t i = 0; i < holders.size(); ++i) {
+            put("      <holder>\n        <tag>");
+            putXml(holders[i].tag);
+            put("</tag>\n        <age>");
+            putNumber(holders[i].age);
+            put("</age>\n        <frames>");
+            for(size_t f = 0; f < holders[i].frames.size(); ++f) {
+                char text[24];
+                int len = snprintf(text, sizeof(text), f ? " %p" : "%p",
+                                   holders[i].frames[f]);
+                put(text, len);
+            }
+            put("</frames>\n      </holder>\n");
+        }
+        put("    </library>\n");
+        break;
+    case LibManager::LIBMGR_DUMP_JSON:
+        put(first ? "\n  {\"name\": \"" : ",\n  {\"name\": \"");
+        putJson(name);
+        put("\", \"references\": ");
+        putInt(references);
+        putHistogram("lockWait", telemetry.lockWait);
+        putHistogram("holdTime", telemetry.holdTime);
+        putHistogram("acquireRate", telemetry.acquireRate);
+        putHistogram("releaseRate", telemetry.releaseRate);
+        put(", \"holders\": [");
+        for(size_t i = 0; i < holders.size(); ++i) {
+            put(i ? ", {\"tag\": \"" : "{\"tag\": \"");
+            putJson(holders[i].tag);
+            put("\", \"age\": ");
+            putNumber(holders[i].age);
+            put(", \"frames\": [");
+            for(size_t f = 0; f < holders[i].frames.size(); ++f) {
+                char text[28];
+                int len = snprintf(text, sizeof(text), f ? ", \"%p\"" : "\"%p\"",
+                                   holders[i].frames[f]);
+                put(text, len);
+            }
+            put("]}");
+        }
+        put("]}");
+        break;
+    case LibManager::LIBMGR_DUMP_BINARY: {
+        putUint32(name.size());
+        put(name);
+        int32_t r = references;
+        put(reinterpret_cast<const char*>(&r), sizeof(r));
+        putHistogram(NULL, telemetry.lockWait);
+        putHistogram(NULL, telemetry.holdTime);
+        putHistogram(NULL, telemetry.acquireRate);
+        putHistogram(NULL, telemetry.releaseRate);
+        putUint32(holders.size());
+        for(size_t i = 0; i < holders.size(); ++i) {
+            putUint64(holders[i].age);
+            putUint32(holders[i].tag.size());
+            put(holders[i].tag);
+            putUint32(holders[i].frames.size());
+            for(size_t f = 0; f < holders[i].frames.size(); ++f) {
+                putUint64(reinterpret_cast<uintptr_t>(holders[i].frames[f]));
+            }
+        }
+        break;
+    }
+    }
+    first = false;
+}
+
+bool DumpWriter::end()
+{
+    switch(format) {
+    case LibManager::LIBMGR_DUMP_XML:
+        put(inTelemetry ? "  </telemetry>\n" : "  </modules>\n");
+        break;
+    case LibManager::LIBMGR_DUMP_JSON:
+        put("\n]}\n");
+        break;
+    case LibManager::LIBMGR_DUMP_BINARY:
+        break;
+    }
+    flush();
+    if(ok && file) {
+        ok = (fflush(file) == 0);
+    }
+    return ok;
+}
+
+void DumpWriter::put(const char *text, size_t len)
+{
+    if(used + len > sizeof(data)) {
+        flush();
+        if(len > sizeof(data)) {
+            writeOut(text, len);
+            return;
+        }
+    }
+    memcpy(data + used, text, len);
+    used += len;
+}
+
+void DumpWriter::putInt(int value)
+{
+    char text[16];
+    int len = snprintf(text, sizeof(text), "%d", value);
+    put(text, len);
+}
+
+void DumpWriter::putUint32(uint32_t value)
+{
+    put(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void DumpWriter::putUint64(uint64_t value)
+{
+    put(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void DumpWriter::putNumber(uint64_t value)
+{
+    char text[24];
+    int len = snprintf(text, sizeof(text), "%llu",
+                       static_cast<unsigned long long>(value));
+    put(text, len);
+}
+
+void DumpWriter::putHistogram(const char *name, const Histogram &histogram)
+{
+    bool any = false;
+    switch(format) {
+    case LibManager::LIBMGR_DUMP_XML:
+        put("      <");
+        put(name, strlen(name));
+        put(">");
+        for(int i = 0; i < Histogram::NUM_BUCKETS; ++i) {
+            if(histogram.buckets[i]) {
+                if(any) {
+                    put(" ");
+                }
+                putInt(i);
+                put(":");
+                putNumber(histogram.buckets[i]);
+                any = true;
+            }
+        }
+        put("</");
+        put(name, strlen(name));
+        put(">\n");
+        break;
+    case LibManager::LIBMGR_DUMP_JSON:
+        put(", \"");
+        put(name, strlen(name));
+        put("\": [");
+        for(int i = 0; i < Histogram::NUM_BUCKETS; ++i) {
+            if(histogram.buckets[i]) {
+                put(any ? ", [" : "[");
+                putInt(i);
+                put(", ");
+                putNumber(histogram.buckets[i]);
+                put("]");
+                any = true;
+            }
+        }
+        put("]");
+        break;
+    case LibManager::LIBMGR_DUMP_BINARY:
+        for(int i = 0; i < Histogram::NUM_BUCKETS; ++i) {
+            putUint64(histogram.buckets[i]);
+        }
+        break;
+    }
+}
+
+void DumpWriter::putXml(string_view text)
+{
+    size_t start = 0;
+    for(size_t i = 0; i < text.size(); ++i) {
+        const char *entity;
+        switch(text[i]) {
+        case '&': entity = "&amp;"; break;
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        default: continue;
+        }
+        put(text.substr(start, i - start));
+        put(entity, strlen(entity));
+        start = i + 1;
+    }
+    put(text.substr(start));
+}
+
+void DumpWriter::putJson(string_view text)
+{
+    size_t start = 0;
+    for(size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = text[i];
+        if(c != '"' && c != '\\' && c >= 0x20) {
+            continue;
+        }
+        put(text.substr(start, i - start));
+        char escaped[8];
+        int len;
+        if(c == '"' || c == '\\') {
+            len = snprintf(escaped, sizeof(escaped), "\\%c", c);
+        } else {
+            len = snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        }
+        put(escaped, len);
+        start = i + 1;
+    }
+    put(text.substr(start));
+}
+
+void DumpWriter::flush()
+{
+    writeOut(data, used);
+    used = 0;
+}
+
+/**
+ * Hands len bytes to the sink, unless an earlier write failed.
+ */
+void DumpWriter::writeOut(const char *text, size_t len)
+{
+    if(!ok || !len) {
+        return;
+    }
+    if(buffer) {
+        buffer->append(text, len);
+    } else if(file) {
+        ok = (fwrite(text, 1, len, file) == len);
+    } else {
+        while(len > 0) {
+#ifdef WIN32
+            int written = _write(fd, text, len);
+#else
+            ssize_t written = write(fd, text, len);
+#endif
+            if(written < 0 && errno == EINTR) {
+                continue;
+            }
+            if(written <= 0) {
+                ok = false;
+                return;
+            }
+            text += written;
+            len -= written;
+        }
+    }
+}
+
+} // end of namespace lib_manager
@@ -0,0 +1,98 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file DumpWriter.h
+ * \brief "DumpWriter" serializes the module list of LibManager::dumpTo().
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_DUMP_WRITER_H
+#define LIB_MANAGER_DUMP_WRITER_H
+
+#include "LibManager.h"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <stdint.h>
+
+namespace lib_manager {
+
+    /**
+     * Writes modules in one of the LibManager::DumpFormats to a FILE, a
+     * file descriptor or a string. Output is collected in a fixed buffer
+     * and written in large blocks; nothing is allocated per module.
+     *
+     * Call begin(), then module() for every module, optionally
+     * beginTelemetry() and telemetry() for every tracked library, then
+     * end(). Write errors are sticky and reported by end().
+     */
+    class DumpWriter {
+    public:
+        DumpWriter(LibManager::DumpFormat format, FILE *file);
+        DumpWriter(LibManager::DumpFormat format, int fd);
+        DumpWriter(LibManager::DumpFormat format, std::string *buffer);
+        DumpWriter(const DumpWriter &) = delete;
+        DumpWriter& operator=(const DumpWriter &) = delete;
+
+        /// numModules is only needed by the binary format.
+        void begin(uint32_t numModules);
+        /// The version is written in XML only if withVersion is set.
+        void module(std::string_view name, std::string_view src,
+                    int version, std::string_view revision,
+                    bool withVersion);
+        /// Ends the module list and starts the LibTelemetry section.
+        void beginTelemetry(uint32_t numLibs);
+        void telemetry(std::string_view name, int references,
+                       const LibTelemetry &telemetry);
+        /// Flushes the buffer. Returns false if anything failed.
+        bool end();
+
+    private:
+        LibManager::DumpFormat format;
+        FILE *file;
+        int fd;
+        std::string *buffer;
+        bool ok;
+        bool first;
+        bool inTelemetry;
+        size_t used;
+        char data[4096];
+
+        void put(const char *text, size_t len);
+        void put(std::string_view text)
+        { put(text.data(), text.size()); }
+        void putInt(int value);
+        void putUint32(uint32_t value);
+        void putUint64(uint64_t value);
+        void putNumber(uint64_t value);
+        void putHistogram(const char *name, const Histogram &histogram);
+        void putXml(std::string_view text);
+        void putJson(std::string_view text);
+        void flush();
+        void writeOut(const char *text, size_t len);
+    }; // class DumpWriter
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_DUMP_WRITER_H */
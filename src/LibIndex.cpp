@@ -0,0 +1,597 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file LibIndex.cpp
+ * \brief "LibIndex" is a persistent index of known plugin libraries.
+ *
+ * File layout (native byte order, checked through FileHeader::byteOrder):
+ *   FileHeader               with the FNV-1a hash of the search path
+ *   FileEntry[numEntries]    sorted by key
+ *   char strings[stringsSize]
+ * All strings are referenced by offset and length into the string table.
+ * The dependencies of an entry are stored as one string with every name
+ * followed by a '\n', its directory times as numDirs int64 values at
+ * dirsOff, unaligned.
+ */
+
+#include "LibIndex.h"
+#include "Logger.h"
+#include "PathResolver.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#ifndef WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+namespace lib_manager {
+
+using namespace std;
+
+static const char indexMagic[8] = { 'L', 'M', 'I', 'N', 'D', 'E', 'X', '\0' };
+static const uint32_t indexByteOrder = 0x01020304;
+static const uint32_t indexFormatVersion = 5;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t formatVersion;
+    uint32_t numEntries;
+    uint32_t stringsSize;
+    uint64_t searchPathHash;
+};
+
+struct FileEntry {
+    uint32_t keyOff, keyLen;
+    uint32_t pathOff, pathLen;
+    uint32_t nameOff, nameLen;
+    uint32_t depsOff, depsLen;
+    uint32_t probed;
+    uint32_t found;
+    int32_t version;
+    uint32_t numDirs;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t inode;
+    uint32_t dirsOff;
+    uint32_t reserved;
+};
+
+bool FileStamp::read(const string &path)
+{
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    size = st.st_size;
+    mtime = PathResolver::modificationTime(st);
+    inode = st.st_ino;
+    return true;
+}
+
+LibIndex::LibIndex(Logger *logger) : logger(logger), data(NULL), dataSize(0),
+                                     dataPathHash(0) {
+}
+
+LibIndex::~LibIndex() {
+    unmap();
+}
+
+bool LibIndex::read(const string &filename)
+{
+    lock_guard<mutex> lock(indexMutex);
+    unmap();
+
+#ifdef WIN32
+    FILE *file = fopen(filename.c_str(), "rb");
+    if(!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if(size > 0) {
+        buffer.resize(size);
+        if(fread(&buffer[0], 1, size, file) != (size_t)size) {
+            buffer.clear();
+        }
+    }
+    fclose(file);
+    if(buffer.empty()) {
+        return false;
+    }
+    data = &buffer[0];
+    dataSize = buffer.size();
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<const char*>(mem);
+    dataSize = st.st_size;
+#endif
+    return validate(filename);
+}
+
+bool LibIndex::attach(const string &name)
+{
+    lock_guard<mutex> lock(indexMutex);
+    unmap();
+#ifdef WIN32
+    LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_WARNING,
+               "LibManager: shared registries are not supported on this "
+               "platform.");
+    return false;
+#else
+    string shmName = sharedName(name);
+    int fd = shm_open(shmName.c_str(), O_RDONLY, 0);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED) {
+        return false;
+    }
+    data = static_cast<const char*>(mem);
+    dataSize = st.st_size;
+    // the publisher writes the magic last
+    atomic_thread_fence(memory_order_acquire);
+    return validate(shmName);
+#endif
+}
+
+/**
+ * Checks the whole layout of the mapped data once, so that lookups do not
+ * have to. Unmaps it if it is not valid. Must be called with the mutex held.
+ */
+bool LibIndex::validate(const string &source)
+{
+    bool valid = dataSize >= sizeof(FileHeader);
+    const FileHeader *header = reinterpret_cast<const FileHeader*>(data);
+    if(valid) {
+        valid = (memcmp(header->magic, indexMagic, sizeof(indexMagic)) == 0 &&
+                 header->byteOrder == indexByteOrder &&
+                 header->formatVersion == indexFormatVersion);
+    }
+    if(valid) {
+        uint64_t needed = sizeof(FileHeader) +
+            (uint64_t)header->numEntries * sizeof(FileEntry) +
+            header->stringsSize;
+        valid = (needed <= dataSize);
+    }
+    if(valid) {
+        const FileEntry *entries =
+            reinterpret_cast<const FileEntry*>(data + sizeof(FileHeader));
+        for(uint32_t i = 0; valid && i < header->numEntries; ++i) {
+            const FileEntry &e = entries[i];
+            valid = ((uint64_t)e.keyOff + e.keyLen <= header->stringsSize &&
+                     (uint64_t)e.pathOff + e.pathLen <= header->stringsSize &&
+                     (uint64_t)e.nameOff + e.nameLen <= header->stringsSize &&
+                     (uint64_t)e.depsOff + e.depsLen <= header->stringsSize &&
+                     (uint64_t)e.dirsOff + (uint64_t)e.numDirs *
+                     sizeof(int64_t) <= header->stringsSize);
+        }
+    }
+    if(!valid) {
+        LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_WARNING,
+                   "LibManager: \"%s\" is not a valid library index.",
+                   source.c_str());
+        unmap();
+        return false;
+    }
+    dataPathHash = header->searchPathHash;
+    if(dataPathHash != currentPathHash()) {
+        LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_INFO,
+                   "LibManager: \"%s\" was built with another library "
+                   "search path and is not used.", source.c_str());
+    }
+    return true;
+}
+
+bool LibIndex::write(const string &filename) const
+{
+    string bytes;
+    serialize(&bytes);
+
+    // write to a temporary file first, so that a concurrently starting
+    // process never maps a half written index
+    string tmpname = filename + ".tmp";
+    FILE *file = fopen(tmpname.c_str(), "wb");
+    if(!file) {
+        LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_ERROR,
+                   "LibManager: cannot write library index \"%s\".",
+                   filename.c_str());
+        return false;
+    }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = (fclose(file) == 0) && ok;
+#ifdef WIN32
+    remove(filename.c_str());
+#endif
+    if(!ok || rename(tmpname.c_str(), filename.c_str()) != 0) {
+        LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_ERROR,
+                   "LibManager: cannot write library index \"%s\".",
+                   filename.c_str());
+        remove(tmpname.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LibIndex::publish(const string &name) const
+{
+#ifdef WIN32
+    LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_WARNING,
+               "LibManager: shared registries are not supported on this "
+               "platform.");
+    return false;
+#else
+    string bytes;
+    serialize(&bytes);
+
+    // Processes that attached to an earlier segment keep their mapping of
+    // it, so it is replaced by a new one instead of written over.
+    string shmName = sharedName(name);
+    shm_unlink(shmName.c_str());
+    int fd = shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0) {
+        LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_ERROR,
+                   "LibManager: cannot create shared registry \"%s\".",
+                   shmName.c_str());
+        return false;
+    }
+    void *mem = MAP_FAILED;
+    if(ftruncate(fd, bytes.size()) == 0) {
+        mem = mmap(NULL, bytes.size(), PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+    }
+    close(fd);
+    if(mem == MAP_FAILED) {
+        LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_ERROR,
+                   "LibManager: cannot create shared registry \"%s\".",
+                   shmName.c_str());
+        shm_unlink(shmName.c_str());
+        return false;
+    }
+    // a process attaching in between sees no magic yet and ignores the
+    // segment until it is complete
+    char *dest = static_cast<char*>(mem);
+    memcpy(dest + sizeof(indexMagic), bytes.data() + sizeof(indexMagic),
+           bytes.size() - sizeof(indexMagic));
+    atomic_thread_fence(memory_order_release);
+    memcpy(dest, bytes.data(), sizeof(indexMagic));
+    munmap(mem, bytes.size());
+    return true;
+#endif
+}
+
+bool LibIndex::unpublish(const string &name)
+{
+#ifdef WIN32
+    return false;
+#else
+    return shm_unlink(sharedName(name).c_str()) == 0;
+#endif
+}
+
+/**
+ * Builds the file layout from the entries of the mapped data and the
+ * recorded entries. Entries resolved with another search path than the
+ * current one are left out.
+ */
+void LibIndex::serialize(string *bytes) const
+{
+    const uint64_t pathHash = currentPathHash();
+    map<string, IndexEntry> entries;
+    {
+        lock_guard<mutex> lock(indexMutex);
+        if(data && dataPathHash == pathHash) {
+            const FileHeader *header =
+                reinterpret_cast<const FileHeader*>(data);
+            for(uint32_t i = 0; i < header->numEntries; ++i) {
+                IndexEntry entry;
+                getMapped(i, &entry);
+                entries[entry.key] = entry;
+            }
+        }
+        for(map<string, IndexEntry>::const_iterator it = recorded.begin();
+            it != recorded.end(); ++it) {
+            if(it->second.searchPathHash == pathHash) {
+                entries[it->first] = it->second;
+            }
+        }
+    }
+
+    // std::map iterates in key order, which is the order lookups expect
+    vector<FileEntry> fileEntries;
+    string strings;
+    fileEntries.reserve(entries.size());
+    for(map<string, IndexEntry>::const_iterator it = entries.begin();
+        it != entries.end(); ++it) {
+        const IndexEntry &entry = it->second;
+        FileEntry e;
+        memset(&e, 0, sizeof(e));
+        e.keyOff = strings.size();
+        e.keyLen = entry.key.size();
+        strings.append(entry.key);
+        e.pathOff = strings.size();
+        e.pathLen = entry.path.size();
+        strings.append(entry.path);
+        e.nameOff = strings.size();
+        e.nameLen = entry.libName.size();
+        strings.append(entry.libName);
+        e.depsOff = strings.size();
+        for(size_t d = 0; d < entry.dependencies.size(); ++d) {
+            strings.append(entry.dependencies[d]);
+            strings.append(1, '\n');
+        }
+        e.depsLen = strings.size() - e.depsOff;
+        e.dirsOff = strings.size();
+        e.numDirs = entry.dirTimes.size();
+        if(!entry.dirTimes.empty()) {
+            strings.append(reinterpret_cast<const char*>(&entry.dirTimes[0]),
+                           entry.dirTimes.size() * sizeof(int64_t));
+        }
+        e.probed = entry.probed;
+        e.found = entry.found;
+        e.version = entry.version;
+        e.size = entry.stamp.size;
+        e.mtime = entry.stamp.mtime;
+        e.inode = entry.stamp.inode;
+        fileEntries.push_back(e);
+    }
+
+    FileHeader header;
+    memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.byteOrder = indexByteOrder;
+    header.formatVersion = indexFormatVersion;
+    header.numEntries = fileEntries.size();
+    header.stringsSize = strings.size();
+    header.searchPathHash = pathHash;
+
+    bytes->clear();
+    bytes->reserve(sizeof(header) + fileEntries.size() * sizeof(FileEntry) +
+                   strings.size());
+    bytes->append(reinterpret_cast<const char*>(&header), sizeof(header));
+    if(!fileEntries.empty()) {
+        bytes->append(reinterpret_cast<const char*>(&fileEntries[0]),
+                      fileEntries.size() * sizeof(FileEntry));
+    }
+    bytes->append(strings);
+}
+
+bool LibIndex::lookup(const string &key, IndexEntry *entry) const
+{
+    const uint64_t pathHash = currentPathHash();
+    {
+        lock_guard<mutex> lock(indexMutex);
+        map<string, IndexEntry>::const_iterator it = recorded.find(key);
+        if(it != recorded.end() && it->second.searchPathHash == pathHash) {
+            *entry = it->second;
+        } else if(dataPathHash != pathHash || !findMapped(key, entry)) {
+            return false;
+        }
+    }
+    // a file that key names, e.g. in the working directory, comes first
+    FileStamp stamp;
+    if(entry->path != key && stamp.read(key)) {
+        return false;
+    }
+    return (stamp.read(entry->path) && stamp == entry->stamp &&
+            dirsUnchanged(entry->dirTimes));
+}
+
+void LibIndex::record(const IndexEntry &entry)
+{
+    const uint64_t pathHash = currentPathHash();
+    vector<int64_t> dirTimes;
+    if(entry.key != entry.path) {
+        readDirTimes(entry.path, &dirTimes);
+    }
+    lock_guard<mutex> lock(indexMutex);
+    IndexEntry &recordedEntry = recorded[entry.key];
+    recordedEntry = entry;
+    recordedEntry.searchPathHash = pathHash;
+    recordedEntry.dirTimes.swap(dirTimes);
+}
+
+void LibIndex::clear()
+{
+    lock_guard<mutex> lock(indexMutex);
+    unmap();
+    recorded.clear();
+}
+
+/**
+ * POSIX shared memory names are a single component starting with a slash.
+ */
+string LibIndex::sharedName(const string &name)
+{
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+/**
+ * FNV-1a hash of the library search path that names are resolved with
+ * right now.
+ */
+uint64_t LibIndex::currentPathHash()
+{
+    const string searchPath = PathResolver::searchPath();
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < searchPath.size(); ++i) {
+        hash ^= static_cast<unsigned char>(searchPath[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * Reads the times of the search directories that were searched to find
+ * path: all up to the one that has path in it, or all if none has.
+ */
+void LibIndex::readDirTimes(const string &path, vector<int64_t> *dirTimes)
+{
+    vector<string> dirPaths;
+    const string searchPath = PathResolver::searchPath();
+    if(!searchPath.empty()) {
+        PathResolver::splitSearchPath(searchPath, &dirPaths);
+    }
+    for(size_t i = 0; i < dirPaths.size(); ++i) {
+        const string &dir = dirPaths[i];
+        dirTimes->push_back(PathResolver::dirTime(dir));
+        // PathResolver::resolve() finds files as dir + "/" + file name
+        if(path.size() > dir.size() + 1 &&
+           path.compare(0, dir.size(), dir) == 0 && path[dir.size()] == '/' &&
+           path.find('/', dir.size() + 1) == string::npos) {
+            break;
+        }
+    }
+}
+
+/**
+ * Checks that the search directories still have the times of readDirTimes().
+ */
+bool LibIndex::dirsUnchanged(const vector<int64_t> &dirTimes)
+{
+    if(dirTimes.empty()) {
+        return true;
+    }
+    vector<string> dirPaths;
+    PathResolver::splitSearchPath(PathResolver::searchPath(), &dirPaths);
+    for(size_t i = 0; i < dirTimes.size(); ++i) {
+        if(i >= dirPaths.size() ||
+           PathResolver::dirTime(dirPaths[i]) != dirTimes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Releases the read file. Must be called with the mutex held.
+ */
+void LibIndex::unmap()
+{
+#ifndef WIN32
+    if(data) {
+        munmap(const_cast<char*>(data), dataSize);
+    }
+#endif
+    buffer.clear();
+    data = NULL;
+    dataSize = 0;
+}
+
+/**
+ * Binary search for key in the mapped file. Must be called with the mutex
+ * held.
+ */
+bool LibIndex::findMapped(const string &key, IndexEntry *entry) const
+{
+    if(!data) {
+        return false;
+    }
+    const FileHeader *header = reinterpret_cast<const FileHeader*>(data);
+    const FileEntry *entries =
+        reinterpret_cast<const FileEntry*>(data + sizeof(FileHeader));
+    const char *strings = data + sizeof(FileHeader) +
+        header->numEntries * sizeof(FileEntry);
+
+    uint32_t low = 0, high = header->numEntries;
+    while(low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        const FileEntry &e = entries[mid];
+        int cmp = key.compare(0, string::npos, strings + e.keyOff, e.keyLen);
+        if(cmp == 0) {
+            getMapped(mid, entry);
+            return true;
+        }
+        if(cmp < 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return false;
+}
+
+/**
+ * Copies entry i of the mapped file. Must be called with the mutex held.
+ */
+void LibIndex::getMapped(uint32_t i, IndexEntry *entry) const
+{
+    const FileHeader *header = reinterpret_cast<const FileHeader*>(data);
+    const FileEntry &e =
+        reinterpret_cast<const FileEntry*>(data + sizeof(FileHeader))[i];
+    const char *strings = data + sizeof(FileHeader) +
+        header->numEntries * sizeof(FileEntry);
+
+    entry->key.assign(strings + e.keyOff, e.keyLen);
+    entry->path.assign(strings + e.pathOff, e.pathLen);
+    entry->libName.assign(strings + e.nameOff, e.nameLen);
+    entry->dependencies.clear();
+    const char *dep = strings + e.depsOff;
+    const char *depsEnd = dep + e.depsLen;
+    while(dep < depsEnd) {
+        const char *end = static_cast<const char*>(memchr(dep, '\n',
+                                                          depsEnd - dep));
+        if(!end) {
+            end = depsEnd;
+        }
+        entry->dependencies.push_back(string(dep, end));
+        dep = end + 1;
+    }
+    entry->dirTimes.resize(e.numDirs);
+    if(e.numDirs) {
+        memcpy(&entry->dirTimes[0], strings + e.dirsOff,
+               e.numDirs * sizeof(int64_t));
+    }
+    entry->probed = e.probed;
+    entry->found = e.found;
+    entry->version = e.version;
+    entry->stamp.size = e.size;
+    entry->stamp.mtime = e.mtime;
+    entry->stamp.inode = e.inode;
+}
+
+} // end of namespace lib_manager
@@ -0,0 +1,192 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file LibIndex.h
+ * \brief "LibIndex" is a persistent index of known plugin libraries.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_LIB_INDEX_H
+#define LIB_MANAGER_LIB_INDEX_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace lib_manager {
+
+    class Logger;
+
+    /// Bits used in IndexEntry::probed and IndexEntry::found.
+    enum IndexSymbol {
+        INDEX_SYM_CREATE = 1 << 0,          ///< create_c
+        INDEX_SYM_CONFIG_CREATE = 1 << 1,   ///< config_create_c
+        INDEX_SYM_DESTROY = 1 << 2,         ///< destroy_c
+        INDEX_SYM_LIB_NAME = 1 << 3,        ///< lib_name_c
+        /// create_c returned an instance, see LibManager::probeLibraries()
+        INDEX_SYM_CONSTRUCTS = 1 << 4,
+        INDEX_SYM_DESCRIPTOR = 1 << 5,      ///< lib_manager_plugin_v2
+    };
+
+    /// Identifies one version of a library file on disk.
+    struct FileStamp {
+        FileStamp() : size(0), mtime(0), inode(0) {}
+
+        uint64_t size;
+        /// In nanoseconds, so that a rebuild of the same size within the
+        /// same second is told apart.
+        int64_t mtime;
+        uint64_t inode;
+
+        bool operator==(const FileStamp &other) const
+        { return (size == other.size && mtime == other.mtime &&
+                  inode == other.inode); }
+
+        /// Fills the stamp from the file. Returns false if there is none.
+        bool read(const std::string &path);
+    };
+
+    struct IndexEntry {
+        IndexEntry() : probed(0), found(0), version(0), searchPathHash(0) {}
+
+        /// The path or name that was passed to LibManager::loadLibrary().
+        std::string key;
+        /// The file the key resolved to.
+        std::string path;
+        FileStamp stamp;
+        /// IndexSymbol bits of the factory symbols that were looked up ...
+        uint32_t probed;
+        /// ... and of those that were found.
+        uint32_t found;
+        /// Results of getLibName() and getLibVersion().
+        std::string libName;
+        int32_t version;
+        /// Result of DependencyInterface::getDependencies().
+        std::vector<std::string> dependencies;
+        /// Hash of the library search path key was resolved with; set by
+        /// LibIndex::record().
+        uint64_t searchPathHash;
+        /// Modification times of the search directories up to and
+        /// including the one path was found in, or of all of them if it
+        /// was not found there; set by LibIndex::record(). Empty if key
+        /// names the file itself.
+        std::vector<int64_t> dirTimes;
+    };
+
+    /**
+     * The index maps the names used to load libraries to the files they
+     * resolved to, together with what is known about the library in that
+     * file. An index can be written to disk and read back by a later run.
+     *
+     * The file is memory mapped and searched in place, like ld.so.cache, so
+     * reading it does not parse or copy anything. New information is
+     * recorded in memory and only ends up on disk with write(). The same
+     * data can be placed in shared memory with publish(), for other
+     * processes to attach() to.
+     *
+     * Which file a name resolves to depends on the library search path, so
+     * the index remembers the search path it was built with. Entries
+     * are only found while the search path is the same, and while none of
+     * the directories searched before the file was found changed, since a
+     * library installed there would now be found instead.
+     *
+     * All methods are thread safe.
+     */
+    class LibIndex {
+    public:
+        explicit LibIndex(Logger *logger);
+        ~LibIndex();
+        LibIndex(const LibIndex &) = delete;
+        LibIndex& operator=(const LibIndex &) = delete;
+
+        /**
+         * Maps an index file. Replaces a previously read file but keeps
+         * everything recorded since. Returns false if the file does not
+         * exist or is not a valid index.
+         */
+        bool read(const std::string &filename);
+
+        /**
+         * Like read(), but maps the POSIX shared memory segment name that
+         * another process created with publish(). Not supported on
+         * Windows.
+         */
+        bool attach(const std::string &name);
+
+        /**
+         * Writes the entries of the read file together with all recorded
+         * entries (which take precedence) to filename.
+         */
+        bool write(const std::string &filename) const;
+
+        /**
+         * Writes the same data as write() to a new POSIX shared memory
+         * segment called name, replacing an existing one. Processes that
+         * attached to the old one keep seeing it. Not supported on Windows.
+         */
+        bool publish(const std::string &name) const;
+
+        /// Removes the shared memory segment created by publish().
+        static bool unpublish(const std::string &name);
+
+        /**
+         * Looks up key and checks that the library file still matches the
+         * stamp in the entry. Returns false if there is no such entry, if
+         * it is stale, or if it was resolved with another search path or
+         * before one of the search directories changed.
+         */
+        bool lookup(const std::string &key, IndexEntry *entry) const;
+
+        /// Stores entry in memory, replacing any entry for the same key.
+        void record(const IndexEntry &entry);
+
+        /// Drops the read file and everything recorded.
+        void clear();
+
+    private:
+        Logger *logger;
+        mutable std::mutex indexMutex;
+        const char *data;
+        size_t dataSize;
+        /// The search path hash of the header of data.
+        uint64_t dataPathHash;
+        std::vector<char> buffer;
+        std::map<std::string, IndexEntry> recorded;
+
+        void unmap();
+        bool validate(const std::string &source);
+        void serialize(std::string *bytes) const;
+        static std::string sharedName(const std::string &name);
+        static uint64_t currentPathHash();
+        static void readDirTimes(const std::string &path,
+                                 std::vector<int64_t> *dirTimes);
+        static bool dirsUnchanged(const std::vector<int64_t> &dirTimes);
+        bool findMapped(const std::string &key, IndexEntry *entry) const;
+        void getMapped(uint32_t i, IndexEntry *entry) const;
+    }; // class LibIndex
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_LIB_INDEX_H */
@@ -29,6 +29,8 @@
 #define LIB_INTERFACE_H
 
 #include <string>
+#include <vector>
+#include <stdint.h>
 
 /* We had to jump through some hoops to get the git version information
  * into the libInterface:
@@ -82,6 +84,15 @@ extern "C" lib_manager::LibInterface* create_c(lib_manager::LibManager *theManag
     return dynamic_cast<lib_manager::LibInterface*>(instance);    \
   }
 
+/* Optional: exports the library name, so that the LibManager can register
+ * the library lazily without constructing it (see LIBMGR_LOAD_LAZY).
+ * theName must match getLibName().
+ */
+#define DECLARE_LIB_NAME(theName)                                       \
+  extern "C" const char* lib_name_c(void) {                             \
+    return theName;                                                     \
+  }
+
 #define CREATE_MODULE_INFO()                                            \
   void createModuleInfo() {                                             \
     moduleInfo.name = getLibName();                                     \
@@ -119,12 +130,179 @@ namespace lib_manager {
         LibManager *libManager;
         ModuleInfo moduleInfo;
     };
+
+    /**
+     * Optional second base class of a library that tells the LibManager
+     * what it depends on. It is not part of LibInterface, so that the
+     * layout of LibInterface, and with it libraries built against older
+     * versions of this header, stay as they were. The LibManager finds it
+     * with a dynamic_cast.
+     */
+    class DependencyInterface {
+    public:
+        virtual ~DependencyInterface(void) {}
+
+        /**
+         * Appends the names of the libraries this library depends on. The
+         * LibManager uses them to order loading and to notify this library
+         * when one of them is loaded.
+         */
+        virtual void getDependencies(std::vector<std::string> *) const {}
+
+        /**
+         * Return true and append library names to receive newLibLoaded()
+         * only for these libraries and the dependencies. By default
+         * newLibLoaded() is called for every library that is loaded.
+         */
+        virtual bool getNewLibLoadedFilter(std::vector<std::string> *) const
+        { return false; }
+    };
+
+    /// The DependencyInterface of lib, or NULL if it does not have one.
+    inline const DependencyInterface* getDependencyInterface(const LibInterface *lib)
+    { return dynamic_cast<const DependencyInterface*>(lib); }
     
     typedef void *destroyLib(LibInterface *sp);
     typedef LibInterface* createLib(LibManager *theManager);
     typedef LibInterface* createLib2(LibManager *theManager, void *configuration);
+    typedef const char* nameLib(void);
+
+    /**
+     * A library that is linked into the program instead of being loaded
+     * from a file, see CREATE_STATIC_LIB.
+     */
+    struct StaticLib {
+        /// The name loadLibrary() finds it by; must match getLibName().
+        const char *name;
+        createLib *create;
+        destroyLib *destroy;
+        StaticLib *next;
+    };
+
+    /**
+     * Makes lib available to all LibManagers. lib must stay valid for the
+     * rest of the program; it is normally a static object.
+     */
+    void registerStaticLib(StaticLib *lib);
+
+    struct StaticLibRegistrar {
+        StaticLibRegistrar(StaticLib *lib)
+        { registerStaticLib(lib); }
+    };
+
+    /**
+     * Version of the binary interface between the LibManager and plugin
+     * libraries, stored in every PluginDescriptor. Increment it whenever
+     * LibInterface or PluginDescriptor change incompatibly.
+     */
+    enum { PLUGIN_ABI_VERSION = 1 };
+
+    /**
+     * Everything the LibManager needs to know about a plugin library, in
+     * one exported object called lib_manager_plugin_v2 (see
+     * CREATE_PLUGIN_DESCRIPTOR). A library that has it is set up with a
+     * single symbol lookup instead of one per factory function, is
+     * rejected before anything is constructed if it was built against an
+     * incompatible LibInterface, and can be registered lazily by name and
+     * version.
+     */
+    struct PluginDescriptor {
+        /// PLUGIN_ABI_VERSION and the sizes of the types plugins share
+        /// with the manager, as seen by the compiler of the plugin.
+        uint32_t abiVersion;
+        uint32_t interfaceSize;
+        uint32_t stringSize;
+        /// Result of getLibName() and getLibVersion().
+        const char *name;
+        int version;
+        createLib *create;
+        /// NULL if the library cannot be loaded with a configuration.
+        createLib2 *configCreate;
+        destroyLib *destroy;
+    };
       
 } // end of namespace lib_manager
+
+/* The static-link variant of CREATE_LIB and DESTROY_LIB: registers the
+ * factory functions of theClass under theName while the program starts.
+ * LibManager::loadLibrary(theName) then constructs the library without
+ * touching the file system or the dynamic linker. Used at most once per
+ * source file. Note that the linker drops object files from a static
+ * archive that nothing refers to; link plugin archives completely, e.g.
+ * with -Wl,--whole-archive.
+ */
+#define CREATE_STATIC_LIB(theClass, theName)                            \
+  namespace {                                                           \
+    lib_manager::LibInterface* lib_manager_static_create(lib_manager::LibManager *theManager) { \
+      theClass *instance = new theClass(theManager);                    \
+      instance->createModuleInfo();                                     \
+      return dynamic_cast<lib_manager::LibInterface*>(instance);        \
+    }                                                                   \
+    void* lib_manager_static_destroy(lib_manager::LibInterface *sp) {   \
+      delete (dynamic_cast<theClass*>(sp));                             \
+      return 0;                                                         \
+    }                                                                   \
+    lib_manager::StaticLib lib_manager_static_lib = {                   \
+      theName, lib_manager_static_create, lib_manager_static_destroy, 0 \
+    };                                                                  \
+    lib_manager::StaticLibRegistrar lib_manager_static_registrar(&lib_manager_static_lib); \
+  }
+
+/* Exports the lib_manager_plugin_v2 descriptor (see PluginDescriptor) of a
+ * plugin library instead of create_c, destroy_c and lib_name_c. theName
+ * and theVersion must match getLibName() and getLibVersion(). The _CONFIG
+ * variant also lets LibManager::loadLibrary() pass a configType*.
+ */
+#define LIB_MANAGER_PLUGIN_FACTORIES(theClass)                          \
+  namespace {                                                           \
+    lib_manager::LibInterface* lib_manager_plugin_create(lib_manager::LibManager *theManager) { \
+      theClass *instance = new theClass(theManager);                    \
+      instance->createModuleInfo();                                     \
+      return dynamic_cast<lib_manager::LibInterface*>(instance);        \
+    }                                                                   \
+    void* lib_manager_plugin_destroy(lib_manager::LibInterface *sp) {   \
+      delete (dynamic_cast<theClass*>(sp));                             \
+      return 0;                                                         \
+    }                                                                   \
+  }
+
+#define LIB_MANAGER_PLUGIN_DESCRIPTOR(theName, theVersion, configCreate) \
+  extern "C" const lib_manager::PluginDescriptor lib_manager_plugin_v2 = { \
+    lib_manager::PLUGIN_ABI_VERSION,                                    \
+    sizeof(lib_manager::LibInterface), sizeof(std::string),             \
+    theName, theVersion, lib_manager_plugin_create, configCreate,       \
+    lib_manager_plugin_destroy                                          \
+  };
+
+#define CREATE_PLUGIN_DESCRIPTOR(theClass, theName, theVersion)         \
+  LIB_MANAGER_PLUGIN_FACTORIES(theClass)                                \
+  LIB_MANAGER_PLUGIN_DESCRIPTOR(theName, theVersion, 0)
+
+#define CREATE_PLUGIN_DESCRIPTOR_CONFIG(theClass, configType, theName, theVersion) \
+  LIB_MANAGER_PLUGIN_FACTORIES(theClass)                                \
+  namespace {                                                           \
+    lib_manager::LibInterface* lib_manager_plugin_config_create(lib_manager::LibManager *theManager, void *config) { \
+      theClass *instance = new theClass(theManager, static_cast<configType*>(config)); \
+      instance->createModuleInfo();                                     \
+      return dynamic_cast<lib_manager::LibInterface*>(instance);        \
+    }                                                                   \
+  }                                                                     \
+  LIB_MANAGER_PLUGIN_DESCRIPTOR(theName, theVersion,                    \
+                                lib_manager_plugin_config_create)
+
+/* Defines the factory functions of a plugin that can be built both ways:
+ * as a loadable library by default, or linked into the program if
+ * LIB_MANAGER_STATIC_PLUGINS is defined.
+ */
+#ifdef LIB_MANAGER_STATIC_PLUGINS
+#define DEFINE_LIB(theClass, theName)                                   \
+  CREATE_STATIC_LIB(theClass, theName)
+#else
+#define DEFINE_LIB(theClass, theName)                                   \
+  DESTROY_LIB(theClass)                                                 \
+  CREATE_LIB(theClass)                                                  \
+  DECLARE_LIB_NAME(theName)
+#endif
   
 #endif  /* LIB_INTERFACE_H */
   
\ No newline at end of file
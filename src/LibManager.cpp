@@ -35,79 +35,368 @@
 #  define LibHandle void*
 #endif
 
+#include "ConfigParser.h"
+#include "DependencyGraph.h"
+#include "DumpWriter.h"
+#include "LibIndex.h"
+#include "LibWatcher.h"
+#include "LoadTrace.h"
+#include "Logger.h"
+#include "PathResolver.h"
+#include "Prober.h"
+#include "Reclaimer.h"
+#include "RefTracker.h"
+#include "ThreadPool.h"
+#include "Warmup.h"
+
+#include <algorithm>
 #include <cstdio>
 #include <stdlib.h>
 #include <stdexcept>
+#include <thread>
 
 namespace lib_manager {
 
 #if defined(_LIBCPP_VERSION)
 // clang's libc++
 static struct LibInfo stdlibInfo = { "libc++", "", _LIBCPP_VERSION,
-                                        "", "", 0 };
+                                        "", "", 0, {} };
 #elif defined(__GLIBCPP__) || defined(__GLIBCXX__)
 // GNU libstdc++
 static struct LibInfo stdlibInfo = { "libstdc++", "",
-                                        (__GNUC__*100+__GNUC_MINOR__),"","",0};
+                                        (__GNUC__*100+__GNUC_MINOR__),"","",0,
+                                        {} };
 #else
 #  warning Unknown standard C Library!
-static struct LibInfo stdlibInfo = { "unknown stdlib", "", 0, "", "", 0 };
+static struct LibInfo stdlibInfo = { "unknown stdlib", "", 0, "", "", 0,
+                                        {} };
 #endif
 
 using namespace std;
 
+/**
+ * Result of the first load phase: the library file is located and mapped
+ * and its factory functions are resolved, but nothing is constructed yet.
+ */
+struct MappedLib {
+    MappedLib() : handle(NULL), destroy(NULL), create(NULL), create2(NULL),
+                  probed(0), found(0), version(0), flags(0), priority(0),
+                  builtin(false), resolveTime(0), mapTime(0), symbolTime(0)
+    {}
+
+    std::string libPath;
+    std::string filepath;
+    FileStamp stamp;
+    /// Library name and dependencies, if known from the index.
+    std::string libName;
+    std::vector<std::string> dependencies;
+    LibHandle handle;
+    destroyLib *destroy;
+    createLib *create;
+    createLib2 *create2;
+    /// IndexSymbol bits of the symbols looked up and found.
+    uint32_t probed, found;
+    /// Library version, if known from the index.
+    int version;
+    /// LoadFlags, with LIBMGR_LOAD_DEFAULTS already resolved.
+    int flags;
+    /// Load order hints from the config file, see loadConfigFile().
+    int priority;
+    std::vector<std::string> extraDependencies;
+    /// True for a StaticLib, which has no file and is never mapped.
+    bool builtin;
+    /// Why mapping failed, e.g. the text of dlerror().
+    std::string errorDetail;
+    /// Durations of the load steps in nanoseconds, see LibStats.
+    int64_t resolveTime, mapTime, symbolTime;
+};
+
 // forward declarations
-static LibHandle intern_loadLib(const string &libPath);
+static LibHandle intern_loadLib(const string &libPath, int flags,
+                                string *error);
+static bool intern_closeLib(LibHandle libHandle, string *error);
+template <typename T>
+static T getFunc(LibHandle libHandle, const string &name, string *error);
+
+/// All StaticLibs, newest first. Constant initialized, so registering
+/// works from any static constructor.
+static std::atomic<StaticLib*> staticLibs(NULL);
+
+void registerStaticLib(StaticLib *lib)
+{
+    lib->next = staticLibs.load();
+    while(!staticLibs.compare_exchange_weak(lib->next, lib)) {
+    }
+}
+
+static const StaticLib* findStaticLib(const string &name)
+{
+    for(const StaticLib *lib = staticLibs.load(); lib; lib = lib->next) {
+        if(name == lib->name) {
+            return lib;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Set while a destroy function runs on a worker thread of destroyDetached().
+ * Libraries it releases the last reference of are collected in unused
+ * instead of being unloaded on the spot, which would wait for the load lock
+ * held by the thread that waits for the worker.
+ */
+struct CascadeScope {
+    const LibManager *manager;
+    std::vector<LibId> *unused;
+};
+static thread_local CascadeScope *cascade = NULL;
+
+/// The last failure of each thread, see LibManager::getLastError().
+static thread_local LibManager::ErrorInfo lastError;
+
+static void setLastError(LibManager::ErrorNumber error, const string &libPath,
+                         const string &detail)
+{
+    lastError.error = error;
+    lastError.libPath = libPath;
+    lastError.detail = detail;
+}
+
+/**
+ * Increments useCount unless it already dropped to zero, i.e. unless the
+ * library is about to be unloaded.
+ */
+static bool tryAcquire(libStruct *theLib)
+{
+    std::atomic<int> &useCount = theLib->useCount;
+    int count = useCount.load(std::memory_order_relaxed);
+    while(count > 0) {
+        if(useCount.compare_exchange_weak(count, count + 1,
+                                          std::memory_order_acq_rel)) {
+            theLib->acquires.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns false if the index already showed that the symbol is missing.
+ */
+static bool symbolAvailable(const MappedLib &lib, uint32_t symbol)
+{
+    return !(lib.probed & symbol) || (lib.found & symbol);
+}
+
+/**
+ * Looks up a factory symbol of lib unless the index knows it is missing,
+ * and notes the result for the index. A missing symbol is logged and noted
+ * in lib->errorDetail if reportMissing is set.
+ */
 template <typename T>
-static T getFunc(LibHandle libHandle, const string &name);
+static T lookupSymbol(MappedLib *lib, uint32_t symbol, const string &name,
+                      Logger *logger, bool reportMissing = true)
+{
+    if(!symbolAvailable(*lib, symbol)) {
+        if(reportMissing) {
+            lib->errorDetail = name + " is missing (from library index)";
+        }
+        return NULL;
+    }
+    string error;
+    T func = getFunc<T>(lib->handle, name, reportMissing ? &error : NULL);
+    if(!func && reportMissing) {
+        LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_ERROR,
+                   "ERROR: lib_manager cannot load library symbol \"%s\"\n"
+                   "       %s", name.c_str(), error.c_str());
+        lib->errorDetail = error;
+    }
+    lib->probed |= symbol;
+    if(func) {
+        lib->found |= symbol;
+    }
+    return func;
+}
+
 
+const std::string LibManager::errMessage[LIBMGR_NUM_ERRORS] = {
+    errorStrings[LIBMGR_NO_ERROR],
+    errorStrings[LIBMGR_ERR_NO_LIBRARY],
+    errorStrings[LIBMGR_ERR_LIBNAME_EXISTS],
+    errorStrings[LIBMGR_ERR_NOT_ABLE_TO_LOAD],
+    errorStrings[LIBMGR_ERR_LIB_IN_USE],
+};
 
-LibManager::LibManager() {
-    errMessage[LIBMGR_NO_ERROR] = "no error";
-    errMessage[LIBMGR_ERR_NO_LIBRARY] = "no library with given name loaded";
-    errMessage[LIBMGR_ERR_LIBNAME_EXISTS] = "library name already exists";
-    errMessage[LIBMGR_ERR_NOT_ABLE_TO_LOAD] = "not able to load library";  
-    errMessage[LIBMGR_ERR_LIB_IN_USE] = "library is still in use";  
+LibManager::LibManager() : firstGeneration(0), numLoadThreads(1),
+                           numDestroyThreads(1),
+                           threadPool(new ThreadPool()),
+                           defaultLoadFlags(LIBMGR_LOAD_EAGER),
+                           prefetch(false),
+                           logger(new Logger()),
+                           pathResolver(new PathResolver(logger)),
+                           libIndex(new LibIndex(logger)),
+                           asyncLoads(0),
+                           loadTrace(new LoadTrace()),
+                           libWatcher(NULL),
+                           reclaimMode(LIBMGR_RECLAIM_IMMEDIATE),
+                           reclaimer(new Reclaimer(
+                               [this](const std::vector<LibId> &ids) {
+                                   sweepUnused(ids);
+                               })),
+                           refTracker(new RefTracker()) {
 }
 
 LibManager::~LibManager() {
-    std::map<std::string, libStruct>::iterator it;
-    clearLibraries();
+    {
+        std::unique_lock<std::mutex> lock(asyncMutex);
+        asyncDone.wait(lock, [this]() { return asyncLoads == 0; });
+    }
+    stopWatching();
+    // queued libraries have no references and go with clearLibraries()
+    reclaimer->stop();
+    ClearReport report;
+    clearLibraries(&report);
 
-    if(!libMap.empty()) {
-        for(it = libMap.begin(); it != libMap.end(); ++it) {
-            fprintf(stderr, "LibManager: [%s] not deleted correctly! "
+    if(!report.leaked.empty()) {
+        for(size_t i = 0; i < report.leaked.size(); ++i) {
+            LIBMGR_LOG(logger, LIBMGR_LOG_WARNING,
+                "LibManager: [%s] not deleted correctly! "
                 "%d references remain.\n"
                 "      NOTE: The semantics of the LibManager has changed. To correctly\n"
                 "            dispose of a library acquired by a call to getLibrary(libName)\n"
                 "            you should now call releaseLibrary(libName) instead\n"
-                "            of unloadLibrary(libName).\n",
-                it->first.c_str(), it->second.useCount);
+                "            of unloadLibrary(libName).",
+                report.leaked[i].name.c_str(), report.leaked[i].references);
+            std::string holders;
+            {
+                std::shared_lock<std::shared_mutex> lock(tableMutex);
+                uint32_t index;
+                if(findLib(report.leaked[i].name, &index)) {
+                    refTracker->describe(index, &holders);
+                }
+            }
+            if(!holders.empty()) {
+                LIBMGR_LOG(logger, LIBMGR_LOG_WARNING,
+                           "LibManager: tracked references of [%s]:\n%s",
+                           report.leaked[i].name.c_str(), holders.c_str());
+            }
         }
     } else {
-        fprintf(stderr, "LibManager: successfully deleted all libraries!\n");
+        LIBMGR_LOG(logger, LIBMGR_LOG_INFO,
+                   "LibManager: successfully deleted all libraries!");
     }
-    fprintf(stderr, "Delete lib_manager\n");
+    delete threadPool;
+    delete reclaimer;
+    delete refTracker;
+    delete loadTrace;
+    delete libIndex;
+    delete pathResolver;
+    LIBMGR_LOG(logger, LIBMGR_LOG_INFO, "Delete lib_manager");
+    delete logger;
 }
 
 /**
-* Empties the libMap field and deletes all items (libStructs) from memory.
+* Deletes all libraries (libStructs) that are no longer referenced.
+*
+* All of them are taken out of the library table at once. They are then
+* destroyed in reverse dependency order, i.e. a library is destroyed before
+* the libraries it depends on. Libraries that do not depend on each other
+* are destroyed in parallel only if more than one destroy thread is set
+* (see setNumDestroyThreads()).
+*
+* @param report If not NULL, receives the destroyed libraries and those that
+*               could not be destroyed because they are still referenced.
 */
-void LibManager::clearLibraries() {
-    std::map<std::string, libStruct>::iterator it;
-    bool finished = false;
-
-    while(!finished) {
-        finished = true;
-        for(it = libMap.begin(); it != libMap.end(); ++it) {
-            if(it->second.useCount == 0) {
-                fprintf(stderr, "LibManager: delete [%s] !\n", it->first.c_str() );
-                if(it->second.destroy) {
-                    it->second.destroy(it->second.libInterface);
+void LibManager::clearLibraries(ClearReport *report) {
+    std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+    std::vector<libStruct> doomed;
+    {
+        std::unique_lock<std::shared_mutex> lock(tableMutex);
+        for(size_t i = 0; i < libSlots.size(); ++i) {
+            if(libSlots[i].isRegistered() && libSlots[i].useCount == 0) {
+                doomed.push_back(libSlots[i]);
+                freeLib(&libSlots[i]);
+            }
+        }
+        if(freeSlots.size() == libSlots.size()) {
+            // nothing is left, so give back all slabs in one go; new slots
+            // start above every old generation to keep old LibIds invalid
+            for(size_t i = 0; i < libSlots.size(); ++i) {
+                firstGeneration = std::max(firstGeneration,
+                                           libSlots[i].generation);
+            }
+            libSlots.clear();
+            freeSlots.clear();
+        }
+    }
+
+    std::vector<std::string> *destroyed = report ? &report->destroyed : NULL;
+    std::vector<LibId> cascaded;
+    destroyDetached(doomed, destroyed, &cascaded);
+    sweepUnused(cascaded, destroyed);
+
+    if(report) {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        for(size_t i = 0; i < libSlots.size(); ++i) {
+            if(libSlots[i].isRegistered()) {
+                report->leaked.push_back(LibInfo());
+                fillLibInfo(libSlots[i], &report->leaked.back());
+            }
+        }
+    }
+}
+
+/**
+ * Destroys libraries that were already taken out of the table, in reverse
+ * dependency order, and unmaps their files. Must be called with the load
+ * lock held.
+ * @param destroyed If not NULL, receives the names in destruction order.
+ * @param cascaded If not NULL, libraries that do not depend on each other
+ *        are destroyed in parallel if more than one destroy thread is set
+ *        (see setNumDestroyThreads()). The
+ *        libraries whose last reference their destroy functions release
+ *        are then added to cascaded, for the caller to sweepUnused() them.
+ *        If NULL, everything runs on the calling thread and such libraries
+ *        are unloaded right away.
+ */
+void LibManager::destroyDetached(const std::vector<libStruct> &doomed,
+                                 std::vector<std::string> *destroyed,
+                                 std::vector<LibId> *cascaded)
+{
+    std::vector<std::string> names(doomed.size());
+    std::vector<std::vector<std::string> > dependencies(doomed.size());
+    for(size_t i = 0; i < doomed.size(); ++i) {
+        names[i] = doomed[i].name;
+        dependencies[i] = doomed[i].dependencies;
+    }
+    std::vector<std::vector<size_t> > levels;
+    sortIntoLevels(names, dependencies, &levels);
+
+    // The libraries are no longer in the table, so nobody else can reach
+    // them. A worker thread cannot take the load lock we hold, so what its
+    // destroy functions release is only collected.
+    unsigned int numThreads = cascaded ? numDestroyThreads : 1;
+    for(size_t l = levels.size(); l-- > 0; ) {
+        const std::vector<size_t> &level = levels[l];
+        std::vector<std::vector<LibId> > unused(level.size());
+        threadPool->parallelFor(level.size(), numThreads, [&](size_t i) {
+                const libStruct &theLib = doomed[level[i]];
+                CascadeScope scope = { this, &unused[i] };
+                CascadeScope *outer = cascade;
+                if(cascaded) {
+                    cascade = &scope;
                 }
-                libMap.erase(it);
-                finished = false;
-                break;
+                destroyInstance(theLib);
+                cascade = outer;
+                unrefHandle(theLib.handle);
+            });
+        for(size_t i = 0; cascaded && i < unused.size(); ++i) {
+            cascaded->insert(cascaded->end(), unused[i].begin(),
+                             unused[i].end());
+        }
+        if(destroyed) {
+            for(size_t i = 0; i < level.size(); ++i) {
+                destroyed->push_back(names[level[i]]);
             }
         }
     }
@@ -115,40 +404,121 @@ void LibManager::clearLibraries() {
 
 /**
 * Registers a new library. An associated libStruct is created and all other
-* registered libraries are informed about the new library by calling the
-* newLibLoaded() method of their interface.
+* registered libraries that are interested (see
+* DependencyInterface::getNewLibLoadedFilter()) are informed about the new
+* library by calling the newLibLoaded() method of their interface.
 * 
 * @param _lib A pointer to any class implementing the LibInterface.
+* @param id If not NULL, receives the LibId of the new library.
 */
-LibManager::ErrorNumber LibManager::addLibrary(LibInterface *_lib, destroyLib *destroyFunc,const std::string &path) {
+LibManager::ErrorNumber LibManager::addLibrary(LibInterface *_lib, destroyLib *destroyFunc,const std::string &path,
+                                               LibId *id) {
     if(!_lib) {
         return lib_manager::LibManager::LIBMGR_ERR_NO_LIBRARY;
     }
-    libStruct newLib(_lib);
-    newLib.destroy = destroyFunc;
-    newLib.path = path;
     
+    std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+
     string name = _lib->getLibName();
     
     _lib->createModuleInfo();
-    
-    if(libMap.find(name) == libMap.end()) {
-        libMap[name] = newLib;
+
+    libStruct newLib(_lib);
+    cacheModuleInfo(_lib, &newLib);
+    newLib.destroy = destroyFunc;
+    newLib.path = path;
+    newLib.name = name;
+    prepareSubscriptions(_lib, &newLib);
+
+    uint32_t index;
+    {
+        std::unique_lock<std::shared_mutex> lock(tableMutex);
+        if(libNames.count(name)) {
+            return LIBMGR_ERR_LIBNAME_EXISTS;
+        }
+        index = claimSlot();
+        newLib.generation = libSlots[index].generation;
+        newLib.index = index;
+        libSlots[index] = newLib;
+        libNames.insert(std::make_pair(std::string_view(libSlots[index].name),
+                                       index));
+        if(id) {
+            *id = LibId(index, newLib.generation);
+        }
+        addSubscriptions(index);
+        indexInterfaces(index);
+    }
         
-        // notify all Libs of newly loaded lib
-        for(map<string, libStruct>::iterator it = libMap.begin();
-            it != libMap.end(); ++it) {
+    notifySubscribers(index, name);
+    
+    return LIBMGR_NO_ERROR;
+}
+
+/**
+ * Collects the dependencies and newLibLoaded() subscriptions of a library
+ * into its libStruct.
+ */
+void LibManager::prepareSubscriptions(const LibInterface *lib,
+                                      libStruct *theLib)
+{
+    theLib->dependencies.clear();
+    theLib->subscriptions.clear();
+    const DependencyInterface *info = getDependencyInterface(lib);
+    if(info) {
+        info->getDependencies(&theLib->dependencies);
+    }
+    theLib->notifyAll = !info ||
+        !info->getNewLibLoadedFilter(&theLib->subscriptions);
+    if(theLib->notifyAll) {
+        theLib->subscriptions.clear();
+        return;
+    }
+    std::vector<std::string> &subscriptions = theLib->subscriptions;
+    subscriptions.insert(subscriptions.end(), theLib->dependencies.begin(),
+                         theLib->dependencies.end());
+    std::sort(subscriptions.begin(), subscriptions.end());
+    subscriptions.erase(std::unique(subscriptions.begin(),
+                                    subscriptions.end()),
+                        subscriptions.end());
+}
+
+/**
+ * Calls newLibLoaded(name) on all constructed libraries that subscribed to
+ * it, in slot order, except on the library in slot index itself. Must be
+ * called with the load lock held, which keeps the libraries alive.
+ */
+void LibManager::notifySubscribers(uint32_t index, const std::string &name)
+{
+    std::vector<LibInterface*> others;
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        std::vector<uint32_t> subscribers(allSubscribers);
+        std::unordered_map<std::string, std::vector<uint32_t> >::const_iterator it;
+        it = libSubscribers.find(name);
+        if(it != libSubscribers.end()) {
+            subscribers.insert(subscribers.end(), it->second.begin(),
+                               it->second.end());
+        }
+        std::sort(subscribers.begin(), subscribers.end());
+        others.reserve(subscribers.size());
+        for(size_t i = 0; i < subscribers.size(); ++i) {
+            const libStruct &other = libSlots[subscribers[i]];
             // not notify the new lib about itself
-            if(it->first != name)
-                it->second.libInterface->newLibLoaded(name);
+            if(subscribers[i] != index && other.libInterface &&
+               other.useCount > 0) {
+                others.push_back(other.libInterface);
             }
+        }
     }
-    else
-    {
-        return LIBMGR_ERR_LIBNAME_EXISTS;
+
+    int64_t start = traceClock();
+    for(size_t i = 0; i < others.size(); ++i) {
+        others[i]->newLibLoaded(name);
     }
-    
-    return LIBMGR_NO_ERROR;
+    int64_t duration = traceClock() - start;
+    loadTrace->record("newLibLoaded", name, start, duration);
+    std::lock_guard<std::mutex> lock(statsMutex);
+    libStats[name].notifyTime = duration;
 }
 
 /**
@@ -157,289 +527,2572 @@ LibManager::ErrorNumber LibManager::addLibrary(LibInterface *_lib, destroyLib *d
 * rather than adding an already-existing instance with the addLibrary method.
 * @param libPath The path to the library.
 * @param config 
+* @param id If not NULL, receives the LibId of the loaded library.
+* @param flags LoadFlags, or LIBMGR_LOAD_DEFAULTS.
 * @return 
 */
 LibManager::ErrorNumber LibManager::loadLibrary(const string &libPath, 
-                                                void *config) 
+                                                void *config, LibId *id,
+                                                int flags) 
 {
-    const char *prefix = "lib";
-#ifdef WIN32
-    const char *suffix = ".dll";
-    const char sep = ';';
-    const char *env = "PATH";
-#elif __APPLE__
-    const char *suffix = ".dylib";
-    const char sep = ':';
-    const char *env = "DYLD_LIBRARY_PATH";
-#else
-    const char *suffix = ".so";
-    const char sep = ':';
-    const char *env = "LD_LIBRARY_PATH";
-#endif
-    fprintf(stderr, "lib_manager: load plugin: %s\n", libPath.c_str());
-    
-    //try to locate the library somewhere by checking at various path positions
-    FILE *testFile = fopen(libPath.c_str(), "r");
-    std::string filepath;
-    if(!testFile) {
-        filepath = prefix;
-        filepath.append(libPath);
-        filepath.append(suffix);
-        char* lib_path = getenv(env);
-        if(lib_path) {
-            // try to first find library
-            std::string lib_path_s(lib_path);
-            size_t next_path_pos = 0;
-            size_t actual_path_pos = 0;
-            while(next_path_pos != string::npos) {
-                next_path_pos = lib_path_s.find(sep, actual_path_pos);
-                string actual_path = lib_path_s.substr(actual_path_pos, (next_path_pos != string::npos) ? next_path_pos - actual_path_pos : lib_path_s.size() - actual_path_pos);
-                actual_path.append("/");
-                std::string actual_lib_path = actual_path;
-                actual_lib_path.append(filepath);
-                testFile = fopen(actual_lib_path.c_str(), "r");
-                if(testFile) {
-                    fclose(testFile);
-                    filepath = actual_lib_path;
-                    fprintf(stderr, "lib_manager: found plugin at: %s\n",
-                            filepath.c_str());
-                    break;
-                }
-                actual_path_pos = next_path_pos + 1;
-            }
+    MappedLib lib;
+    pathResolver->nextGeneration();
+    locateLib(libPath, &lib);
+    return loadMapped(&lib, config, id, flags, false);
+}
+
+/**
+ * Finishes loading a located library: maps it unless this was already done
+ * or can be skipped, then constructs it, or only registers it if it is to
+ * be loaded lazily.
+ */
+LibManager::ErrorNumber LibManager::loadMapped(MappedLib *lib, void *config,
+                                               LibId *id, int flags,
+                                               bool mapped)
+{
+    if(flags == LIBMGR_LOAD_DEFAULTS) {
+        flags = defaultLoadFlags;
+    }
+    lib->flags = flags;
+    bool lazy = !config && (flags & LIBMGR_LOAD_LAZY);
+    if(lazy && canDefer(*lib)) {
+        return registerLazyLib(*lib, id);
+    }
+    if(!mapped) {
+        mapLib(lib, config != NULL, lazy);
+    }
+    if(lazy && canDefer(*lib)) {
+        return registerLazyLib(*lib, id);
+    }
+    return constructLib(*lib, config, id);
+}
+                                                
+/**
+ * Finds the file to load for libPath. A StaticLib of that name is used
+ * without looking at any file. If the index has a valid entry for libPath,
+ * the recorded file is used without searching, and what the index knows
+ * about the library is copied to lib. Only touches the thread safe path
+ * cache and index.
+ */
+void LibManager::locateLib(const string &libPath, MappedLib *lib)
+{
+    int64_t start = traceClock();
+    IndexEntry entry;
+    const StaticLib *builtin = findStaticLib(libPath);
+    bool indexed = !builtin && libIndex->lookup(libPath, &entry);
+
+    lib->libPath = libPath;
+    if(builtin) {
+        // linked in; already "mapped" with all symbols known
+        lib->builtin = true;
+        lib->libName = builtin->name;
+        lib->create = builtin->create;
+        lib->destroy = builtin->destroy;
+        lib->probed = lib->found = (INDEX_SYM_CREATE | INDEX_SYM_DESTROY |
+                                    INDEX_SYM_LIB_NAME);
+    } else if(indexed) {
+        lib->filepath = entry.path;
+        lib->stamp = entry.stamp;
+        lib->probed = entry.probed;
+        lib->found = entry.found;
+        lib->libName = entry.libName;
+        lib->version = entry.version;
+        lib->dependencies = entry.dependencies;
+    } else {
+        lib->filepath = pathResolver->resolve(libPath);
+        if(!lib->stamp.read(lib->filepath)) {
+            // left to the dynamic linker's own search; nothing to index
+            lib->stamp = FileStamp();
         }
     }
-    else {
-        filepath = libPath;
-        fclose(testFile);
+    lib->resolveTime = traceClock() - start;
+    loadTrace->record("resolve", libPath, start, lib->resolveTime);
+    loadEvent(LIBMGR_EVENT_RESOLVED, *lib);
+}
+
+/**
+ * First load phase: maps the located library and resolves its factory
+ * functions. Symbols the index knows to be missing are not looked up again,
+ * and if destroy_c is known to be missing the library is not even mapped.
+ * If wantName is set and the name is not known yet, lib_name_c is looked
+ * up as well. Does not touch the library table and can therefore run on
+ * several threads at once.
+ */
+void LibManager::mapLib(MappedLib *lib, bool withConfig, bool wantName)
+{
+    if(lib->builtin) {
+        if(withConfig) {
+            lib->errorDetail = "static libraries take no configuration";
+        } else {
+            loadEvent(LIBMGR_EVENT_MAPPED, *lib);
+        }
+        return;
     }
-    
-    
-    LibInterface *interface = NULL;
-    destroyLib *destroyFunc = NULL;
-    
-    LibHandle pl = intern_loadLib(filepath);
-    
-    if(pl) {
-        destroyFunc = getFunc<destroyLib*>(pl, "destroy_c");
-        if(destroyFunc) {
-            if(!config) {
-                createLib *tmp_con = getFunc<createLib*>(pl, "create_c");
-                if(tmp_con)
-                {
-                    interface = tmp_con(this);
-                }
+
+    LIBMGR_LOG(logger, LIBMGR_LOG_INFO, "lib_manager: load plugin: %s",
+               lib->libPath.c_str());
+
+    if(!symbolAvailable(*lib, INDEX_SYM_DESTROY)) {
+        LIBMGR_LOG(logger, LIBMGR_LOG_ERROR, "ERROR: lib_manager: \"%s\" has "
+                   "no destroy_c (from library index)", lib->filepath.c_str());
+        lib->errorDetail = "destroy_c is missing (from library index)";
+        return;
+    }
+    if(!symbolAvailable(*lib, INDEX_SYM_CONSTRUCTS)) {
+        LIBMGR_LOG(logger, LIBMGR_LOG_ERROR, "ERROR: lib_manager: \"%s\" failed "
+                   "probeLibraries() (from library index)",
+                   lib->filepath.c_str());
+        lib->errorDetail = "the library failed the probe (from library index)";
+        return;
+    }
+
+    int64_t start = traceClock();
+    lib->handle = intern_loadLib(lib->filepath, lib->flags, &lib->errorDetail);
+    lib->mapTime = traceClock() - start;
+    loadTrace->record("dlopen", lib->libPath, start, lib->mapTime);
+    if(!lib->handle) {
+        LIBMGR_LOG(logger, LIBMGR_LOG_ERROR, "ERROR: lib_manager cannot load "
+                   "library:\n       %s", lib->errorDetail.c_str());
+    } else if((lib->flags & LIBMGR_LOAD_LOCKED) && !lockLibrary(lib->handle)) {
+        LIBMGR_LOG(logger, LIBMGR_LOG_WARNING, "LibManager: cannot lock \"%s\" "
+                   "in memory", lib->filepath.c_str());
+    }
+
+    const PluginDescriptor *plugin = NULL;
+    if(lib->handle) {
+        start = traceClock();
+        plugin = lookupSymbol<const PluginDescriptor*>(lib,
+                                                       INDEX_SYM_DESCRIPTOR,
+                                                       "lib_manager_plugin_v2",
+                                                       logger, false);
+    }
+    if(plugin) {
+        // one lookup for everything; nothing else is looked up
+        if(checkPlugin(plugin, &lib->errorDetail)) {
+            lib->destroy = plugin->destroy;
+            lib->create = plugin->create;
+            lib->create2 = plugin->configCreate;
+            lib->libName = plugin->name;
+            lib->version = plugin->version;
+            // the factories stand in for the symbols, so that the index
+            // knows them and canDefer() works without mapping next time
+            lib->probed |= (INDEX_SYM_CREATE | INDEX_SYM_CONFIG_CREATE |
+                            INDEX_SYM_DESTROY);
+            lib->found |= ((plugin->create ? INDEX_SYM_CREATE : 0) |
+                           (plugin->configCreate ? INDEX_SYM_CONFIG_CREATE : 0) |
+                           INDEX_SYM_DESTROY);
+            if(withConfig && !lib->create2) {
+                lib->errorDetail = "the library takes no configuration";
+            }
+        } else {
+            LIBMGR_LOG(logger, LIBMGR_LOG_ERROR, "ERROR: lib_manager: \"%s\" "
+                       "is incompatible: %s", lib->filepath.c_str(),
+                       lib->errorDetail.c_str());
+        }
+        lib->symbolTime = traceClock() - start;
+        loadTrace->record("symbols", lib->libPath, start, lib->symbolTime);
+    } else if(lib->handle) {
+        lib->destroy = lookupSymbol<destroyLib*>(lib, INDEX_SYM_DESTROY,
+                                                 "destroy_c", logger);
+        if(lib->destroy) {
+            if(!withConfig) {
+                lib->create = lookupSymbol<createLib*>(lib, INDEX_SYM_CREATE,
+                                                       "create_c", logger);
             } else {
-                createLib2 *tmp_con2 = getFunc<createLib2*>(pl, "config_create_c");
-                if(tmp_con2)
-                {
-                    interface = tmp_con2(this, config);
-                }
+                lib->create2 = lookupSymbol<createLib2*>(lib,
+                                                         INDEX_SYM_CONFIG_CREATE,
+                                                         "config_create_c",
+                                                         logger);
+            }
+        }
+        if(wantName && lib->create && lib->libName.empty()) {
+            nameLib *name = lookupSymbol<nameLib*>(lib, INDEX_SYM_LIB_NAME,
+                                                   "lib_name_c", logger, false);
+            if(name) {
+                lib->libName = name();
             }
         }
+        lib->symbolTime = traceClock() - start;
+        loadTrace->record("symbols", lib->libPath, start, lib->symbolTime);
     }
-
-    if(!interface)
-        return LIBMGR_ERR_NOT_ABLE_TO_LOAD;
-
-    LibManager::ErrorNumber error = addLibrary(interface, destroyFunc, libPath);
-    if(error != LIBMGR_NO_ERROR)
-    {
-        destroyFunc(interface);
+    if(lib->destroy && (lib->create || lib->create2)) {
+        loadEvent(LIBMGR_EVENT_MAPPED, *lib);
     }
-    
-    return LIBMGR_NO_ERROR;
 }
-                                                
+
 /**
-* Returns a pointer to the libStruct associated with the requested library.
-* @param libName The name of the requested library.
-* @return A libStruct* if library is registered, otherwise 0.
-*/
-LibInterface* LibManager::acquireLibrary(const string &libName) 
+ * Returns true if lib can be registered without constructing it, which
+ * needs its name and its factory functions.
+ */
+bool LibManager::canDefer(const MappedLib &lib) const
 {
-    if(libMap.find(libName) == libMap.end()) {
-        fprintf(stderr, "LibManager: could not find \"%s\"\n", libName.c_str());
-        return NULL;
-    }
-    libStruct *theLib = &(libMap[libName]);
-    theLib->useCount++;
-    return theLib->libInterface;
+    const uint32_t needed = INDEX_SYM_CREATE | INDEX_SYM_DESTROY;
+    return !lib.libName.empty() && (lib.found & needed) == needed;
 }
 
 /**
- * Releases a previously acquired library
- * @param libName
- * @return 
+ * Registers a library that is constructed on its first acquisition. No
+ * other library is notified until then.
  */
-LibManager::ErrorNumber LibManager::releaseLibrary(const string &libName) 
+LibManager::ErrorNumber LibManager::registerLazyLib(const MappedLib &lib,
+                                                    LibId *id)
 {
-    if(libMap.find(libName) == libMap.end()) {
-        return LIBMGR_ERR_NO_LIBRARY;
+    recordLib(lib, NULL);
+    std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+    std::unique_lock<std::shared_mutex> lock(tableMutex);
+    if(libNames.count(lib.libName)) {
+        // like in constructLib(), loading a library twice is no error
+        lock.unlock();
+        closeHandle(lib.handle);
+        return LIBMGR_NO_ERROR;
     }
-    
-    libStruct *theLib = &(libMap[libName]);
-    theLib->useCount--;
-    if(theLib->useCount < 0)
-    {
-        throw std::runtime_error("Internal error, use count is below zero !");
+    uint32_t index = claimSlot();
+
+    libStruct &newLib = libSlots[index];
+    newLib.pending = true;
+    newLib.useCount = 1;
+    newLib.path = lib.libPath;
+    newLib.name = lib.libName;
+    libNames.insert(std::make_pair(std::string_view(newLib.name), index));
+    newLib.filepath = lib.filepath;
+    newLib.create = lib.create;
+    newLib.destroy = lib.destroy;
+    newLib.version = lib.version;
+    newLib.dependencies = lib.dependencies;
+    newLib.loadFlags = lib.flags;
+    newLib.handle = refHandle(lib.handle);
+    if(id) {
+        *id = LibId(index, newLib.generation);
     }
-    if(theLib->useCount == 0) {
-        unloadLibrary(libName);
+    lock.unlock();
+    if(libWatcher && lib.stamp.size) {
+        libWatcher->watch(lib.filepath);
     }
+    LIBMGR_LOG(logger, LIBMGR_LOG_INFO, "lib_manager: registered lazy "
+               "plugin: %s", lib.libName.c_str());
+    recordLoadStats(lib.libName, lib, 0);
+    loadEvent(LIBMGR_EVENT_REGISTERED, lib);
     return LIBMGR_NO_ERROR;
 }
 
 /**
- * This method is not to be directly called. Use releaseLibrary() instead.
+ * Maps and constructs a lazily registered library, then notifies the other
+ * libraries about it. The caller must hold a reference to the library. If
+ * construction fails, the library is removed from the table.
+ * @return true if the library is constructed.
  */
-LibManager::ErrorNumber LibManager::unloadLibrary(const string &libName) 
+bool LibManager::instantiateLib(LibId id)
 {
-    if(libMap.find(libName) == libMap.end()) {
-        return LIBMGR_ERR_NO_LIBRARY;
+    std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+    MappedLib lib;
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        libStruct *theLib = getLib(id);
+        if(!theLib) {
+            return false;
+        }
+        if(!theLib->pending) {
+            // constructed by another thread in the meantime
+            return theLib->libInterface != NULL;
+        }
+        lib.libPath = theLib->path;
+        lib.filepath = theLib->filepath;
+        lib.libName = theLib->name;
+        lib.create = theLib->create;
+        lib.destroy = theLib->destroy;
+        lib.flags = theLib->loadFlags;
     }
-    
-    libStruct *theLib = &(libMap[libName]);
-    if(theLib->useCount < 0)
+    lib.stamp.read(lib.filepath);
+
+    if(!lib.create) {
+        mapLib(&lib, false, false);
+    }
+    LibInterface *interface = NULL;
+    int64_t start = traceClock();
+    if(lib.create && lib.destroy) {
+        interface = lib.create(this);
+    }
+    int64_t createTime = traceClock() - start;
+    loadTrace->record("create", lib.libName, start, createTime);
+    recordLib(lib, interface);
+    loadEvent(interface ? LIBMGR_EVENT_CONSTRUCTED : LIBMGR_EVENT_FAILED, lib,
+              interface ? LIBMGR_NO_ERROR : LIBMGR_ERR_NOT_ABLE_TO_LOAD);
+
+    if(interface && interface->getLibName() != lib.libName) {
+        LIBMGR_LOG(logger, LIBMGR_LOG_WARNING, "LibManager: lazy plugin "
+                   "\"%s\" calls itself \"%s\"", lib.libName.c_str(),
+                   interface->getLibName().c_str());
+    }
+    libStruct constructed;
+    if(interface) {
+        interface->createModuleInfo();
+        cacheModuleInfo(interface, &constructed);
+        prepareSubscriptions(interface, &constructed);
+    }
+
+    // a handle in lib is new here; the lazily registered library only has
+    // one if the file was already mapped, and then create is known too
+    void *oldHandle = NULL;
     {
-        throw std::runtime_error("Internal error, use count is below zero !");
+        std::unique_lock<std::shared_mutex> lock(tableMutex);
+        libStruct *theLib = getLib(id);
+        if(!interface) {
+            LIBMGR_LOG(logger, LIBMGR_LOG_ERROR, "LibManager: cannot "
+                       "construct lazy plugin \"%s\"", lib.libName.c_str());
+            if(theLib) {
+                oldHandle = theLib->handle;
+                freeLib(theLib);
+            }
+        }
+    }
+    if(!interface) {
+        unrefHandle(oldHandle);
+        closeHandle(lib.handle);
+        setLastError(LIBMGR_ERR_NOT_ABLE_TO_LOAD, lib.libPath, lib.errorDetail);
+        return false;
     }
-    if(theLib->useCount == 0) {
-        fprintf(stderr, "LibManager: unload delete [%s]\n", libName.c_str());
-        if(theLib->destroy) {
-            theLib->destroy(theLib->libInterface);
+
+    {
+        std::unique_lock<std::shared_mutex> lock(tableMutex);
+        libStruct *theLib = getLib(id);
+        if(lib.handle) {
+            theLib->handle = refHandle(lib.handle);
         }
-        libMap.erase(libName);
-        return LIBMGR_NO_ERROR;
+        theLib->libInterface = interface;
+        theLib->destroy = lib.destroy;
+        theLib->create = lib.create;
+        theLib->pending = false;
+        theLib->version = constructed.version;
+        theLib->src.swap(constructed.src);
+        theLib->revision.swap(constructed.revision);
+        theLib->dependencies.swap(constructed.dependencies);
+        theLib->notifyAll = constructed.notifyAll;
+        theLib->subscriptions.swap(constructed.subscriptions);
+        addSubscriptions(id.index);
+        indexInterfaces(id.index);
     }
-    return LIBMGR_ERR_LIB_IN_USE;
+
+    recordLoadStats(lib.libName, lib, createTime);
+    notifySubscribers(id.index, lib.libName);
+    return true;
 }
 
 /**
- * Loads all libraries specified in a configuration file. The configuration file
- * has to be a text file that contains one library path per line; each can have
- * a maximum length of 255 characters.
- * @param config_file
+ * Second load phase: creates the library instance and registers it with the
+ * manager. What was learned about the library is recorded in the index.
+ * Runs under the load lock.
  */
-void LibManager::loadConfigFile(const std::string &config_file) 
+LibManager::ErrorNumber LibManager::constructLib(const MappedLib &lib,
+                                                 void *config, LibId *id)
 {
-    const size_t maxChars = 255;
-    char plugin_chars[maxChars];
-    std::string plugin_path;
-    FILE *plugin_config;
-    
-    plugin_config = fopen(config_file.c_str() , "r");
-    if(!plugin_config) {
-        fprintf(stderr, "LibManager::loadConfigFile: file \"%s\" not found.\n",
-                config_file.c_str());
-        return;
+    std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+    LibInterface *interface = NULL;
+
+    int64_t start = traceClock();
+    if(lib.destroy) {
+        if(!config) {
+            if(lib.create)
+            {
+                interface = lib.create(this);
+            }
+        } else {
+            if(lib.create2)
+            {
+                interface = lib.create2(this, config);
+            }
+        }
     }
-    
-    //check every input line for a library to load and if one is found, try to load it
-    while(fgets(plugin_chars, maxChars, plugin_config)) {
-        plugin_path = plugin_chars;
-        // strip whitespaces from start and end of line
-        size_t pos1 = plugin_path.find_first_not_of(" \t\n\r");
-        size_t pos2 = plugin_path.find_last_not_of(" \t\n\r");
-        if(pos1 == string::npos || pos2 == string::npos) {
-            continue;
+
+    recordLib(lib, interface);
+
+    if(!interface) {
+        closeHandle(lib.handle);
+        if(lib.errorDetail.empty()) {
+            MappedLib failed(lib);
+            failed.errorDetail = "the library factory returned NULL";
+            loadEvent(LIBMGR_EVENT_FAILED, failed, LIBMGR_ERR_NOT_ABLE_TO_LOAD);
+            setLastError(LIBMGR_ERR_NOT_ABLE_TO_LOAD, lib.libPath,
+                         failed.errorDetail);
+        } else {
+            loadEvent(LIBMGR_EVENT_FAILED, lib, LIBMGR_ERR_NOT_ABLE_TO_LOAD);
+            setLastError(LIBMGR_ERR_NOT_ABLE_TO_LOAD, lib.libPath,
+                         lib.errorDetail);
         }
-        plugin_path = plugin_path.substr(pos1, pos2 - pos1 + 1);
-        // ignore lines that start with #
-        if(plugin_path[0] != '#') {
-            loadLibrary(plugin_path);
+        return LIBMGR_ERR_NOT_ABLE_TO_LOAD;
+    }
+    int64_t createTime = traceClock() - start;
+    MappedLib named(lib);
+    named.libName = interface->getLibName();
+    loadTrace->record("create", named.libName, start, createTime);
+    loadEvent(LIBMGR_EVENT_CONSTRUCTED, named);
+
+    LibId newId;
+    LibManager::ErrorNumber error = addLibrary(interface, lib.destroy,
+                                               lib.libPath, &newId);
+    if(error != LIBMGR_NO_ERROR)
+    {
+        lib.destroy(interface);
+        closeHandle(lib.handle);
+        loadEvent(LIBMGR_EVENT_FAILED, named, error);
+        setLastError(error, lib.libPath, named.libName);
+    } else {
+        std::unique_lock<std::shared_mutex> lock(tableMutex);
+        libStruct *theLib = getLib(newId);
+        theLib->loadFlags = lib.flags;
+        theLib->filepath = lib.filepath;
+        theLib->handle = refHandle(lib.handle);
+        if(id) {
+            *id = newId;
         }
     }
-    fclose(plugin_config);
+    if(libWatcher && error == LIBMGR_NO_ERROR && lib.handle) {
+        libWatcher->watch(lib.filepath);
+    }
+    if(error == LIBMGR_NO_ERROR) {
+        recordLoadStats(named.libName, lib, createTime);
+        loadEvent(LIBMGR_EVENT_REGISTERED, named);
+    }
+    
+    return LIBMGR_NO_ERROR;
 }
 
 /**
- * Accepts a pointer to a list of type LibInterface and appends pointers to 
- * all registered libraries.
- * @param libList
+ * Records what was learned while loading lib in the index. interface is
+ * NULL if the library was not constructed; then only what is already known
+ * from lib_name_c or an earlier index entry is kept.
  */
-void LibManager::getAllLibraries(std::list<LibInterface*> *libList) 
+void LibManager::recordLib(const MappedLib &lib,
+                           const LibInterface *interface)
 {
-    std::map<std::string, libStruct>::iterator it;
-    for(it = libMap.begin(); it != libMap.end(); ++it) {
-        it->second.useCount++;
-        libList->push_back(it->second.libInterface);
+    if(!lib.handle || !lib.stamp.size) {
+        return;
+    }
+    IndexEntry entry;
+    entry.key = lib.libPath;
+    entry.path = lib.filepath;
+    entry.stamp = lib.stamp;
+    entry.probed = lib.probed;
+    entry.found = lib.found;
+    if(interface) {
+        entry.libName = interface->getLibName();
+        entry.version = interface->getLibVersion();
+        const DependencyInterface *info = getDependencyInterface(interface);
+        if(info) {
+            info->getDependencies(&entry.dependencies);
+        }
+    } else {
+        entry.libName = lib.libName;
+        entry.version = lib.version;
+        entry.dependencies = lib.dependencies;
     }
+    libIndex->record(entry);
 }
 
 /**
- * Accepts a pointer to a string list and appends the names of the registered libraries.
- * @param libNameList A pointer to a list of strings.
+ * Maps an index file written by writeIndex() in an earlier run. Libraries
+ * found in a still valid index entry are loaded without searching the
+ * library path and without looking up symbols known to be missing.
+ * @param filename
+ * @return false if the file does not exist or is not a valid index.
  */
-void LibManager::getAllLibraryNames(std::list<std::string> *libNameList) const 
+bool LibManager::readIndex(const std::string &filename)
 {
-    std::map<std::string, libStruct>::const_iterator it;
-    for(it = libMap.begin(); it != libMap.end(); ++it) {
-        libNameList->push_back(it->first);
-    }
+    return libIndex->read(filename);
 }
 
 /**
- * Accepts a constant string and returns a LibInfo struct.
- * @param libName
- * @return 
+ * Writes everything known about the libraries loaded so far, together with
+ * the entries of the index read by readIndex(), to filename.
+ * @param filename
+ * @return false if the file could not be written.
  */
-LibInfo LibManager::getLibraryInfo(const std::string &libName) const 
+bool LibManager::writeIndex(const std::string &filename) const
 {
-    LibInfo info;
-    std::map<std::string, libStruct>::const_iterator it;
-    it = libMap.find(libName);
-    if(it != libMap.end()) {
-        ModuleInfo modInfo = it->second.libInterface->getModuleInfo();
-        info.name = libName;
-        info.path = it->second.path;
-        info.version = it->second.libInterface->getLibVersion();
-        info.src = modInfo.src;
-        info.revision = modInfo.revision;
-        info.references = it->second.useCount;
-    }
-    return info;
+    return libIndex->write(filename);
 }
 
 /**
- * Writes the names, source and revision of all registered libraries to the specified file.
- * @param filepath The path of the file where the names should be dumped.
+ * Checks that a plugin library was built against a LibInterface that is
+ * compatible with the one of this LibManager: same PLUGIN_ABI_VERSION and
+ * same sizes of the shared types (which e.g. differ between the two
+ * std::string ABIs of libstdc++).
+ * @param plugin The lib_manager_plugin_v2 descriptor of the library.
+ * @param error If not NULL, receives what does not match.
  */
-void LibManager::dumpTo(const std::string &filepath) const 
+bool LibManager::checkPlugin(const PluginDescriptor *plugin,
+                             std::string *error)
 {
-    std::list<std::string> libNames;
-    std::list<std::string>::const_iterator libNamesIt;
-    getAllLibraryNames(&libNames);
-    FILE *file = fopen(filepath.c_str(), "w");
-    
-    fprintf(file, "  <modules>\n");
-    for(libNamesIt = libNames.begin();
-        libNamesIt != libNames.end(); ++libNamesIt) 
-    {
-        lib_manager::LibInfo info = getLibraryInfo(*libNamesIt);
-    
-        fprintf(file,
-                "    <module>\n"
-                "      <name>%s</name>\n"
-                "      <src>%s</src>\n"
-                "      <revision>%s</revision>\n"
-                "    </module>\n",
-                info.name.c_str(), info.src.c_str(), info.revision.c_str());
-    }
-    fprintf(file,
-            "    <module>\n"
-            "      <name>%s</name>\n"
-            "      <src>%s</src>\n"
-            "      <version>%d</version>\n"
-            "      <revision>%s</revision>\n"
-            "    </module>\n",
-            stdlibInfo.name.c_str(), stdlibInfo.src.c_str(),
-            stdlibInfo.version, stdlibInfo.revision.c_str());
-    fprintf(file, "  </modules>\n");
-    fclose(file);
+    std::string reason;
+    if(plugin->abiVersion != PLUGIN_ABI_VERSION) {
+        reason = "plugin ABI version " + std::to_string(plugin->abiVersion) +
+            ", expected " + std::to_string((int)PLUGIN_ABI_VERSION);
+    } else if(plugin->interfaceSize != sizeof(LibInterface) ||
+              plugin->stringSize != sizeof(std::string)) {
+        reason = "built with a different LibInterface or std::string layout";
+    } else if(!plugin->create || !plugin->destroy || !plugin->name) {
+        reason = "the plugin descriptor is incomplete";
+    }
+    if(error) {
+        *error = reason;
+    }
+    return reason.empty();
 }
 
-    ////////////////////
+/**
+ * Tries out libraries before they are loaded: each file is mapped and
+ * constructed in a child process of its own, so that a library that
+ * crashes or hangs in create_c only takes down that child. Up to
+ * numWorkers children run in parallel. The children are forked with the
+ * libraries loaded so far, so a library can find its dependencies if they
+ * were loaded before.
+ *
+ * The results go into the library index like those of a regular load.
+ * Afterwards libraries that failed are not even mapped by loadLibrary()
+ * until their file changes, they are probed again or clearIndex() is
+ * called. Libraries that cannot be mapped at all are not recorded, since
+ * that often depends on the environment rather than on the file. Neither
+ * are libraries whose child timed out: it may only have been stuck on a
+ * lock some thread held while it was forked.
+ *
+ * The children are not exec'd, they run create_c right in the copy of
+ * this process. So nothing is probed while the library watcher, the
+ * background reclaimer or an asynchronous load runs; every library then
+ * counts as rejected. Threads of the application that use the manager
+ * should not run either. Not supported on Windows.
+ * @param libPaths Paths or names, as they will be passed to loadLibrary().
+ * @param numWorkers The number of child processes running at once.
+ * @param timeoutMs How long a child may take before it is killed.
+ * @param rejected If not NULL, receives the paths that failed.
+ * @return The number of libraries that passed.
+ */
+size_t LibManager::probeLibraries(const std::vector<std::string> &libPaths,
+                                  unsigned int numWorkers,
+                                  unsigned int timeoutMs,
+                                  std::vector<std::string> *rejected)
+{
+#ifdef WIN32
+    (void)numWorkers;
+    (void)timeoutMs;
+    LIBMGR_LOG(logger, LIBMGR_LOG_WARNING,
+               "LibManager: probing libraries is not supported on this "
+               "platform.");
+    if(rejected) {
+        rejected->insert(rejected->end(), libPaths.begin(), libPaths.end());
+    }
+    return 0;
+#else
+    std::vector<ProbeResult> batch;
+    std::vector<FileStamp> stamps;
+    std::vector<size_t> jobs;
+    size_t passed = 0;
+    for(size_t i = 0; i < libPaths.size(); ++i) {
+        if(findStaticLib(libPaths[i])) {
+            // linked in, nothing can go wrong while mapping it
+            ++passed;
+            continue;
+        }
+        batch.push_back(ProbeResult());
+        batch.back().filepath = pathResolver->resolve(libPaths[i]);
+        stamps.push_back(FileStamp());
+        stamps.back().read(batch.back().filepath);
+        jobs.push_back(i);
+    }
+
+    {
+        std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+        // the children are forked without exec, so a lock another thread of
+        // the manager holds at that moment would never be released in them
+        const char *busy = NULL;
+        if(libWatcher) {
+            busy = "the library watcher runs";
+        } else if(reclaimMode == LIBMGR_RECLAIM_BACKGROUND) {
+            busy = "the background reclaimer runs";
+        } else {
+            std::lock_guard<std::mutex> lock(asyncMutex);
+            if(asyncLoads) {
+                busy = "asynchronous loads run";
+            }
+        }
+        if(busy) {
+            for(size_t j = 0; j < batch.size(); ++j) {
+                batch[j].detail = std::string("not probed while ") + busy;
+            }
+        } else {
+            probeFiles(this, &batch, numWorkers, timeoutMs);
+        }
+    }
+
+    for(size_t j = 0; j < jobs.size(); ++j) {
+        const std::string &libPath = libPaths[jobs[j]];
+        const ProbeResult &result = batch[j];
+        if(result.status == PROBE_OK) {
+            ++passed;
+        } else {
+            LIBMGR_LOG(logger, LIBMGR_LOG_WARNING,
+                       "LibManager: \"%s\" failed the probe: %s",
+                       libPath.c_str(), result.detail.c_str());
+            if(rejected) {
+                rejected->push_back(libPath);
+            }
+        }
+        if(result.status == PROBE_NOT_RUN || result.status == PROBE_TIMEOUT ||
+           result.status == PROBE_NOT_LOADABLE || !stamps[j].size) {
+            continue;
+        }
+        IndexEntry entry;
+        entry.key = libPath;
+        entry.path = result.filepath;
+        entry.stamp = stamps[j];
+        entry.probed = result.probed;
+        entry.found = result.found;
+        if(result.status == PROBE_CRASHED ||
+           result.status == PROBE_INCOMPATIBLE) {
+            entry.probed |= INDEX_SYM_CONSTRUCTS;
+            entry.found &= ~INDEX_SYM_CONSTRUCTS;
+        }
+        entry.libName = result.libName;
+        entry.version = result.version;
+        entry.dependencies = result.dependencies;
+        libIndex->record(entry);
+    }
+    return passed;
+#endif
+}
+
+/**
+ * Publishes what writeIndex() would write as a POSIX shared memory segment
+ * called name. The other processes on the machine that load the same
+ * libraries can then attachRegistry() instead of resolving paths and
+ * probing symbols. All of them map the same pages, so the registry exists
+ * only once in memory, and tools can look at it without asking any of the
+ * processes. The libraries themselves are still mapped by each process.
+ *
+ * Publishing again replaces the segment; processes that are attached to
+ * the old one keep using it. Not supported on Windows.
+ * @param name A name like "/mars_plugins"; the slash is added if missing.
+ * @return false if the segment could not be created.
+ */
+bool LibManager::publishRegistry(const std::string &name) const
+{
+    return libIndex->publish(name);
+}
+
+/**
+ * Uses the registry published under name by another process, read only,
+ * in place of an index file read by readIndex(). What this process learns
+ * on its own is recorded in memory as usual.
+ * @return false if there is no such registry or it is not complete yet.
+ */
+bool LibManager::attachRegistry(const std::string &name)
+{
+    return libIndex->attach(name);
+}
+
+/**
+ * Removes the registry published under name. Processes that are attached
+ * keep their mapping.
+ */
+bool LibManager::removeRegistry(const std::string &name)
+{
+    return LibIndex::unpublish(name);
+}
+
+/**
+ * Forgets the read index file and everything recorded since.
+ */
+void LibManager::clearIndex()
+{
+    libIndex->clear();
+}
+
+/**
+ * Returns the LibId of the library registered under libName.
+ * @param libName The name of the requested library.
+ * @return An invalid LibId if there is no such library.
+ */
+LibId LibManager::getLibraryId(const std::string &libName) const
+{
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    uint32_t index;
+    const libStruct *theLib = findLib(libName, &index);
+    if(!theLib) {
+        return LibId();
+    }
+    return LibId(index, theLib->generation);
+}
+
+/**
+* Returns a pointer to the libStruct associated with the requested library.
+* @param libName The name of the requested library.
+* @return A libStruct* if library is registered, otherwise 0.
+*/
+LibInterface* LibManager::acquireLibrary(const string &libName) 
+{
+    LibId id;
+    {
+        int64_t waitStart = lockWaitStart();
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        uint32_t index;
+        libStruct *theLib = findLib(libName, &index);
+        if(theLib && acquireRef(theLib, waitStart)) {
+            if(!theLib->pending) {
+                return theLib->libInterface;
+            }
+            id = LibId(index, theLib->generation);
+        }
+    }
+    if(id.isValid()) {
+        LibInterface *lib = acquirePending(id);
+        if(lib) {
+            return lib;
+        }
+    }
+    LIBMGR_LOG(logger, LIBMGR_LOG_DEBUG, "LibManager: could not find \"%s\"",
+               libName.c_str());
+    setLastError(LIBMGR_ERR_NO_LIBRARY, libName, std::string());
+    return NULL;
+}
+
+/**
+ * Same as acquireLibrary(const std::string&) but without a name lookup.
+ * @param id A LibId returned by loadLibrary(), addLibrary() or getLibraryId().
+ * @return NULL if the library is no longer registered.
+ */
+LibInterface* LibManager::acquireLibrary(LibId id)
+{
+    {
+        int64_t waitStart = lockWaitStart();
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        libStruct *theLib = getLib(id);
+        if(!theLib || !acquireRef(theLib, waitStart)) {
+            return NULL;
+        }
+        if(!theLib->pending) {
+            return theLib->libInterface;
+        }
+    }
+    return acquirePending(id);
+}
+
+/**
+ * Second half of acquiring a lazily loaded library: the reference is
+ * already taken, now the library is constructed.
+ */
+LibInterface* LibManager::acquirePending(LibId id)
+{
+    if(!instantiateLib(id)) {
+        return NULL;
+    }
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    libStruct *theLib = getLib(id);
+    return theLib ? theLib->libInterface : NULL;
+}
+
+/**
+ * Acquires a library and casts it to an interface type, the part of
+ * acquireLibraryAs() that does not depend on the type. The name lookup, the
+ * reference and the cast cache of the library are all handled with the
+ * table lock taken once. The reference is dropped again if the library
+ * does not implement the type.
+ */
+void* LibManager::acquireCast(const std::string &libName,
+                              const std::type_index &type, CastFunc *cast)
+{
+    LibId id;
+    bool pending;
+    {
+        int64_t waitStart = lockWaitStart();
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        uint32_t index;
+        libStruct *theLib = findLib(libName, &index);
+        if(!theLib || !acquireRef(theLib, waitStart)) {
+            return NULL;
+        }
+        pending = theLib->pending;
+        if(!pending) {
+            void *result = lookupCast(theLib, type, cast);
+            if(result) {
+                return result;
+            }
+        }
+        id = LibId(index, theLib->generation);
+    }
+    return finishCast(id, pending, type, cast);
+}
+
+void* LibManager::acquireCast(LibId id, const std::type_index &type,
+                              CastFunc *cast)
+{
+    bool pending;
+    {
+        int64_t waitStart = lockWaitStart();
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        libStruct *theLib = getLib(id);
+        if(!theLib || !acquireRef(theLib, waitStart)) {
+            return NULL;
+        }
+        pending = theLib->pending;
+        if(!pending) {
+            void *result = lookupCast(theLib, type, cast);
+            if(result) {
+                return result;
+            }
+        }
+    }
+    return finishCast(id, pending, type, cast);
+}
+
+/**
+ * The rest of acquireCast() once the reference is taken, for a library that
+ * still has to be constructed or that does not implement the type.
+ */
+void* LibManager::finishCast(LibId id, bool pending,
+                             const std::type_index &type, CastFunc *cast)
+{
+    if(pending) {
+        if(!acquirePending(id)) {
+            // the reference went with the library that failed to construct
+            return NULL;
+        }
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        // we hold a reference, so the slot still has the same library
+        void *result = lookupCast(getLib(id), type, cast);
+        if(result) {
+            return result;
+        }
+    }
+    releaseLibrary(id);
+    return NULL;
+}
+
+/**
+ * Returns the cached cast of a constructed library to type, casting and
+ * caching it first if this is the first time. Must be called with the
+ * table lock held.
+ */
+void* LibManager::lookupCast(libStruct *theLib, const std::type_index &type,
+                             CastFunc *cast)
+{
+    {
+        std::shared_lock<std::shared_mutex> castLock(castMutex);
+        for(size_t i = 0; i < theLib->casts.size(); ++i) {
+            if(theLib->casts[i].first == type) {
+                return theLib->casts[i].second;
+            }
+        }
+    }
+    void *result = cast(theLib->libInterface);
+    std::unique_lock<std::shared_mutex> castLock(castMutex);
+    bool found = false;
+    for(size_t i = 0; !found && i < theLib->casts.size(); ++i) {
+        found = (theLib->casts[i].first == type);
+    }
+    if(!found) {
+        theLib->casts.push_back(std::make_pair(type, result));
+    }
+    return result;
+}
+
+/**
+ * Returns the LibIds of all constructed libraries that implement type, the
+ * part of findLibrariesImplementing() that does not depend on the type. The
+ * first call for a type casts every library with cast and remembers the
+ * result; afterwards indexInterfaces() keeps the list up to date.
+ */
+void LibManager::findImplementers(const std::type_index &type, CastFunc *cast,
+                                  std::vector<LibId> *ids)
+{
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    std::unique_lock<std::shared_mutex> castLock(castMutex);
+    size_t t = 0;
+    while(t < implementers.size() && implementers[t].type != type) {
+        ++t;
+    }
+    if(t == implementers.size()) {
+        Implementers entry(type, cast);
+        for(uint32_t i = 0; i < libSlots.size(); ++i) {
+            libStruct &theLib = libSlots[i];
+            if(!theLib.libInterface || theLib.pending) {
+                continue;
+            }
+            void *result = NULL;
+            bool cached = false;
+            for(size_t c = 0; c < theLib.casts.size(); ++c) {
+                if(theLib.casts[c].first == type) {
+                    result = theLib.casts[c].second;
+                    cached = true;
+                    break;
+                }
+            }
+            if(!cached) {
+                result = cast(theLib.libInterface);
+                theLib.casts.push_back(std::make_pair(type, result));
+            }
+            if(result) {
+                entry.slots.push_back(i);
+            }
+        }
+        implementers.push_back(entry);
+    }
+
+    const std::vector<uint32_t> &slots = implementers[t].slots;
+    ids->reserve(slots.size());
+    for(size_t i = 0; i < slots.size(); ++i) {
+        ids->push_back(LibId(slots[i], libSlots[slots[i]].generation));
+    }
+}
+
+/**
+ * Casts a newly constructed library to every type findImplementers() was
+ * asked for. Must be called with the table lock held exclusively.
+ */
+void LibManager::indexInterfaces(uint32_t index)
+{
+    libStruct &theLib = libSlots[index];
+    for(size_t t = 0; t < implementers.size(); ++t) {
+        void *result = implementers[t].cast(theLib.libInterface);
+        theLib.casts.push_back(std::make_pair(implementers[t].type, result));
+        if(result) {
+            implementers[t].slots.push_back(index);
+        }
+    }
+}
+
+/**
+ * Removes the slot from the implementer lists. Must be called with the table
+ * lock held exclusively.
+ */
+void LibManager::unindexInterfaces(uint32_t index)
+{
+    for(size_t t = 0; t < implementers.size(); ++t) {
+        std::vector<uint32_t> &slots = implementers[t].slots;
+        slots.erase(std::remove(slots.begin(), slots.end(), index),
+                    slots.end());
+    }
+}
+
+/**
+ * Releases a previously acquired library
+ * @param libName
+ * @return 
+ */
+LibManager::ErrorNumber LibManager::releaseLibrary(const string &libName) 
+{
+    return releaseLibrary(getLibraryId(libName));
+}
+
+/**
+ * Same as releaseLibrary(const std::string&) but without a name lookup.
+ * @param id
+ * @return 
+ */
+LibManager::ErrorNumber LibManager::releaseLibrary(LibId id)
+{
+    int useCount;
+    {
+        int64_t waitStart = lockWaitStart();
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        libStruct *theLib = getLib(id);
+        if(!theLib) {
+            return LIBMGR_ERR_NO_LIBRARY;
+        }
+        trackRelease(theLib, theLib->useCount, waitStart);
+        useCount = --theLib->useCount;
+        theLib->releases.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    if(useCount < 0)
+    {
+        throw std::runtime_error("Internal error, use count is below zero !");
+    }
+    if(useCount == 0) {
+        reclaimUnused(std::vector<LibId>(1, id));
+    }
+    return LIBMGR_NO_ERROR;
+}
+
+/**
+ * Acquires several libraries at once, e.g. all plugins needed for one
+ * frame. All names are looked up under one table lock; only libraries
+ * that are registered lazily and not constructed yet need more.
+ * @param libNames count names of libraries.
+ * @param libs Array of count entries that receives the libraries, NULL for
+ *        those that do not exist.
+ * @param ids If not NULL, array of count entries that receives the LibIds,
+ *        e.g. to release the batch again with releaseLibraries().
+ * @return The number of libraries acquired.
+ */
+size_t LibManager::acquireLibraries(const string *libNames, size_t count,
+                                    LibInterface **libs, LibId *ids)
+{
+    size_t acquired = 0;
+    std::vector<size_t> pending;
+    std::vector<LibId> pendingIds;
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        for(size_t i = 0; i < count; ++i) {
+            uint32_t index;
+            libStruct *theLib = findLib(libNames[i], &index);
+            LibId id;
+            libs[i] = NULL;
+            if(theLib && acquireRef(theLib)) {
+                id = LibId(index, theLib->generation);
+                if(theLib->pending) {
+                    pending.push_back(i);
+                    pendingIds.push_back(id);
+                } else {
+                    libs[i] = theLib->libInterface;
+                    ++acquired;
+                }
+            }
+            if(ids) {
+                ids[i] = id;
+            }
+        }
+    }
+    for(size_t p = 0; p < pending.size(); ++p) {
+        libs[pending[p]] = acquirePending(pendingIds[p]);
+        if(libs[pending[p]]) {
+            ++acquired;
+        } else if(ids) {
+            ids[pending[p]] = LibId();
+        }
+    }
+    if(acquired < count) {
+        for(size_t i = 0; i < count; ++i) {
+            if(!libs[i]) {
+                LIBMGR_LOG(logger, LIBMGR_LOG_DEBUG,
+                           "LibManager: could not find \"%s\"",
+                           libNames[i].c_str());
+                setLastError(LIBMGR_ERR_NO_LIBRARY, libNames[i],
+                             std::string());
+            }
+        }
+    }
+    return acquired;
+}
+
+/**
+ * Same as acquireLibraries(const std::string*, size_t, LibInterface**,
+ * LibId*) but without name lookups.
+ */
+size_t LibManager::acquireLibraries(const LibId *ids, size_t count,
+                                    LibInterface **libs)
+{
+    size_t acquired = 0;
+    std::vector<size_t> pending;
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        for(size_t i = 0; i < count; ++i) {
+            libStruct *theLib = getLib(ids[i]);
+            libs[i] = NULL;
+            if(!theLib || !acquireRef(theLib)) {
+                continue;
+            }
+            if(theLib->pending) {
+                pending.push_back(i);
+            } else {
+                libs[i] = theLib->libInterface;
+                ++acquired;
+            }
+        }
+    }
+    for(size_t p = 0; p < pending.size(); ++p) {
+        libs[pending[p]] = acquirePending(ids[pending[p]]);
+        if(libs[pending[p]]) {
+            ++acquired;
+        }
+    }
+    return acquired;
+}
+
+/**
+ * Releases several libraries at once. The names are looked up and the
+ * references dropped under one table lock. Libraries whose last reference
+ * is dropped are unloaded together afterwards, in reverse dependency order,
+ * or queued as set by setReclaimMode().
+ * A name that is given n times is released n times.
+ * @return The number of references released.
+ */
+size_t LibManager::releaseLibraries(const string *libNames, size_t count)
+{
+    size_t released = 0;
+    std::vector<LibId> unused;
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        for(size_t i = 0; i < count; ++i) {
+            uint32_t index;
+            libStruct *theLib = findLib(libNames[i], &index);
+            if(theLib && dropRef(theLib, LibId(index, theLib->generation),
+                                 &unused)) {
+                ++released;
+            }
+        }
+    }
+    reclaimUnused(unused);
+    return released;
+}
+
+/**
+ * Same as releaseLibraries(const std::string*, size_t) but without name
+ * lookups.
+ */
+size_t LibManager::releaseLibraries(const LibId *ids, size_t count)
+{
+    size_t released = 0;
+    std::vector<LibId> unused;
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        for(size_t i = 0; i < count; ++i) {
+            libStruct *theLib = getLib(ids[i]);
+            if(theLib && dropRef(theLib, ids[i], &unused)) {
+                ++released;
+            }
+        }
+    }
+    reclaimUnused(unused);
+    return released;
+}
+
+/**
+ * Drops one reference of a library for releaseLibraries(). If it was the
+ * last one, id is added to unused. Must be called with the table lock held.
+ * @return false if the library was already unused.
+ */
+bool LibManager::dropRef(libStruct *theLib, LibId id,
+                         std::vector<LibId> *unused)
+{
+    int useCount = theLib->useCount.load(std::memory_order_relaxed);
+    do {
+        if(useCount <= 0) {
+            return false;
+        }
+    } while(!theLib->useCount.compare_exchange_weak(useCount, useCount - 1,
+                                                    std::memory_order_acq_rel));
+    theLib->releases.fetch_add(1, std::memory_order_relaxed);
+    trackRelease(theLib, useCount);
+    if(useCount == 1) {
+        unused->push_back(id);
+    }
+    return true;
+}
+
+/**
+ * tryAcquire() that also records the reference while reference tracking is
+ * on. lockWait is the lockWaitStart() from before taking the table lock,
+ * or -1. Must be called with the table lock held.
+ */
+bool LibManager::acquireRef(libStruct *theLib, int64_t lockWait)
+{
+    if(!tryAcquire(theLib)) {
+        return false;
+    }
+    if(refTracker->isEnabled()) {
+        refTracker->acquired(theLib->index, theLib->useCount,
+                             lockWait < 0 ? -1 : traceClock() - lockWait);
+    }
+    return true;
+}
+
+/**
+ * Records a released reference while reference tracking is on, see
+ * acquireRef(). references is the use count before the release. Must be
+ * called with the table lock held.
+ */
+void LibManager::trackRelease(libStruct *theLib, int references,
+                              int64_t lockWait)
+{
+    if(refTracker->isEnabled()) {
+        refTracker->released(theLib->index, references,
+                             lockWait < 0 ? -1 : traceClock() - lockWait);
+    }
+}
+
+/**
+ * Returns the time to measure the wait for the table lock from, or -1 if
+ * reference tracking is off and the wait is not measured.
+ */
+int64_t LibManager::lockWaitStart() const
+{
+    return refTracker->isEnabled() ? traceClock() : -1;
+}
+
+/**
+ * Handles libraries whose last reference was just released: they are
+ * unloaded, queued as set by setReclaimMode(), or, from a destroy function
+ * running on a worker of destroyDetached(), collected for its caller.
+ */
+void LibManager::reclaimUnused(const std::vector<LibId> &unused)
+{
+    if(unused.empty()) {
+        return;
+    }
+    if(cascade && cascade->manager == this) {
+        cascade->unused->insert(cascade->unused->end(), unused.begin(),
+                                unused.end());
+    } else if(reclaimMode == LIBMGR_RECLAIM_IMMEDIATE) {
+        sweepUnused(unused);
+    } else {
+        for(size_t i = 0; i < unused.size(); ++i) {
+            reclaimer->push(unused[i]);
+        }
+    }
+}
+
+/**
+ * Unloads the libraries that releaseLibraries() dropped the last reference
+ * of: all of them are taken out of the table under one lock and then
+ * destroyed together. So are the libraries their destroy functions release
+ * in turn, in further passes.
+ * @param destroyed If not NULL, receives the names in destruction order.
+ * @return The number of libraries destroyed.
+ */
+size_t LibManager::sweepUnused(const std::vector<LibId> &unused,
+                               std::vector<std::string> *destroyed)
+{
+    if(unused.empty()) {
+        return 0;
+    }
+    std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+    size_t numDestroyed = 0;
+    std::vector<LibId> pending(unused);
+    while(!pending.empty()) {
+        std::vector<libStruct> doomed;
+        doomed.reserve(pending.size());
+        {
+            std::unique_lock<std::shared_mutex> lock(tableMutex);
+            for(size_t i = 0; i < pending.size(); ++i) {
+                libStruct *theLib = getLib(pending[i]);
+                if(!theLib || theLib->useCount != 0) {
+                    continue;
+                }
+                doomed.push_back(*theLib);
+                freeLib(theLib);
+            }
+        }
+        for(size_t i = 0; i < doomed.size(); ++i) {
+            LIBMGR_LOG(logger, LIBMGR_LOG_INFO,
+                       "LibManager: unload delete [%s]",
+                       doomed[i].name.c_str());
+        }
+        pending.clear();
+        destroyDetached(doomed, destroyed, &pending);
+        numDestroyed += doomed.size();
+    }
+    return numDestroyed;
+}
+
+/**
+ * Chooses what happens to libraries whose last reference is released.
+ *
+ * By default they are destroyed right away, so releaseLibrary() runs the
+ * destroy function of the library on the calling thread. With
+ * LIBMGR_RECLAIM_DEFERRED they are only queued, and destroyed when
+ * reclaimLibraries() is called, e.g. at a safe point of a real time loop.
+ * With LIBMGR_RECLAIM_BACKGROUND a background thread destroys them. Either
+ * way releasing just decrements the use count and appends to the queue.
+ *
+ * A queued library cannot be acquired any more, but it keeps its name
+ * until it is destroyed, so it cannot be loaded again before that.
+ * Switching back to LIBMGR_RECLAIM_IMMEDIATE destroys everything queued.
+ */
+void LibManager::setReclaimMode(ReclaimMode mode)
+{
+    reclaimMode = mode;
+    if(mode == LIBMGR_RECLAIM_BACKGROUND) {
+        reclaimer->start();
+    } else {
+        reclaimer->stop();
+    }
+    if(mode == LIBMGR_RECLAIM_IMMEDIATE) {
+        reclaimLibraries();
+    }
+}
+
+/**
+ * Destroys the libraries queued since the last call, see setReclaimMode().
+ * @return The number of libraries destroyed.
+ */
+size_t LibManager::reclaimLibraries()
+{
+    std::vector<LibId> queued;
+    reclaimer->take(&queued);
+    return sweepUnused(queued);
+}
+
+/**
+ * This method is not to be directly called. Use releaseLibrary() instead.
+ */
+LibManager::ErrorNumber LibManager::unloadLibrary(const string &libName) 
+{
+    return unloadLib(getLibraryId(libName));
+}
+
+/**
+ * Replaces a library by a fresh copy of its file: the instance is
+ * destroyed, the file is unmapped and then loaded again from the same path
+ * and with the same LoadFlags (but never lazily). The new instance gets a
+ * new LibId and the other libraries are notified about it as usual.
+ *
+ * Apart from the reference of the loader nobody may hold the library.
+ * Libraries registered with addLibrary() cannot be reloaded.
+ * @param libName The name of the library.
+ * @param id If not NULL, receives the LibId of the new instance.
+ */
+LibManager::ErrorNumber LibManager::reloadLibrary(const string &libName,
+                                                  LibId *id)
+{
+    std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+    libStruct oldLib;
+    {
+        std::unique_lock<std::shared_mutex> lock(tableMutex);
+        libStruct *theLib = findLib(libName);
+        if(!theLib) {
+            return LIBMGR_ERR_NO_LIBRARY;
+        }
+        if(theLib->useCount > 1) {
+            return LIBMGR_ERR_LIB_IN_USE;
+        }
+        if(theLib->path.empty()) {
+            return LIBMGR_ERR_NOT_ABLE_TO_LOAD;
+        }
+        oldLib = *theLib;
+        freeLib(theLib);
+    }
+
+    LIBMGR_LOG(logger, LIBMGR_LOG_INFO, "LibManager: reload [%s]",
+               oldLib.name.c_str());
+    destroyInstance(oldLib);
+    unrefHandle(oldLib.handle);
+#ifndef WIN32
+    if(oldLib.handle && !oldLib.filepath.empty()) {
+        void *handle = dlopen(oldLib.filepath.c_str(), RTLD_LAZY | RTLD_NOLOAD);
+        if(handle) {
+            dlclose(handle);
+            LIBMGR_LOG(logger, LIBMGR_LOG_WARNING, "LibManager: \"%s\" is "
+                       "still mapped, the old code is used again.",
+                       oldLib.filepath.c_str());
+        }
+    }
+#endif
+    return loadLibrary(oldLib.path, NULL, id,
+                       oldLib.loadFlags & ~LIBMGR_LOAD_LAZY);
+}
+
+/**
+ * Reloads several libraries in one pass: all of them are destroyed first,
+ * dependents before their dependencies, and then loaded again with
+ * loadLibraries(). Libraries that are still in use, unknown, or were
+ * registered with addLibrary() are skipped.
+ * @param libNames The names of the libraries.
+ * @return LIBMGR_NO_ERROR, or the error of the last skipped library.
+ */
+LibManager::ErrorNumber LibManager::reloadLibraries(const std::vector<std::string> &libNames)
+{
+    std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+    ErrorNumber error = LIBMGR_NO_ERROR;
+    std::vector<libStruct> doomed;
+    std::vector<std::string> paths;
+    std::vector<int> flags;
+    {
+        std::unique_lock<std::shared_mutex> lock(tableMutex);
+        for(size_t i = 0; i < libNames.size(); ++i) {
+            libStruct *theLib = findLib(libNames[i]);
+            if(!theLib) {
+                error = LIBMGR_ERR_NO_LIBRARY;
+                continue;
+            }
+            if(theLib->useCount > 1 || theLib->path.empty()) {
+                LIBMGR_LOG(logger, LIBMGR_LOG_WARNING, "LibManager: cannot "
+                           "reload [%s]", theLib->name.c_str());
+                error = (theLib->useCount > 1 ? LIBMGR_ERR_LIB_IN_USE :
+                         LIBMGR_ERR_NOT_ABLE_TO_LOAD);
+                continue;
+            }
+            paths.push_back(theLib->path);
+            // libraries that were not constructed yet stay lazy
+            flags.push_back(theLib->pending ? theLib->loadFlags :
+                            theLib->loadFlags & ~LIBMGR_LOAD_LAZY);
+            doomed.push_back(*theLib);
+            freeLib(theLib);
+        }
+    }
+    if(doomed.empty()) {
+        return error;
+    }
+
+    LIBMGR_LOG(logger, LIBMGR_LOG_INFO, "LibManager: reload %lu libraries",
+               (unsigned long)doomed.size());
+    // libraries the old instances released for good go before the new
+    // ones are constructed, just as if they had been unloaded one by one
+    std::vector<LibId> cascaded;
+    destroyDetached(doomed, NULL, &cascaded);
+    sweepUnused(cascaded);
+    loadLibraries(paths, &flags);
+    return error;
+}
+
+/**
+ * Starts reloading libraries automatically whenever their file is replaced
+ * (see reloadLibraries()). Changes are collected until no file changed for
+ * debounceMs milliseconds, so that installing many plugins at once causes
+ * only one reload pass. The reloads run on a background thread.
+ * @return false if watching is not supported on this platform.
+ */
+bool LibManager::startWatching(unsigned int debounceMs)
+{
+    std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+    if(libWatcher) {
+        return true;
+    }
+    LibWatcher *watcher = new LibWatcher(logger, debounceMs,
+                                         [this](const std::vector<std::string> &files) {
+                                             filesChanged(files);
+                                         });
+    if(!watcher->start()) {
+        delete watcher;
+        return false;
+    }
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    for(size_t i = 0; i < libSlots.size(); ++i) {
+        if(libSlots[i].isRegistered() && !libSlots[i].filepath.empty()) {
+            watcher->watch(libSlots[i].filepath);
+        }
+    }
+    libWatcher = watcher;
+    return true;
+}
+
+void LibManager::stopWatching()
+{
+    LibWatcher *watcher;
+    {
+        std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+        watcher = libWatcher;
+        libWatcher = NULL;
+    }
+    // without the load lock, a reload pass in progress has to finish first
+    delete watcher;
+}
+
+/**
+ * Called by the LibWatcher with the files that changed.
+ */
+void LibManager::filesChanged(const std::vector<std::string> &filepaths)
+{
+    std::vector<std::string> names;
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        for(size_t i = 0; i < libSlots.size(); ++i) {
+            const libStruct &theLib = libSlots[i];
+            if(theLib.isRegistered() &&
+               std::find(filepaths.begin(), filepaths.end(),
+                         theLib.filepath) != filepaths.end()) {
+                names.push_back(theLib.name);
+            }
+        }
+    }
+    if(!names.empty()) {
+        reloadLibraries(names);
+    }
+}
+
+/**
+ * Same as loadLibrary(), but runs on a new thread. The returned future
+ * yields the result. Progress can be followed with a LoadListener. The
+ * LibManager waits for all asynchronous loads before it is destroyed.
+ */
+std::future<LibManager::ErrorNumber> LibManager::loadLibraryAsync(const std::string &libPath,
+                                                                  void *config,
+                                                                  int flags)
+{
+    std::promise<ErrorNumber> promise;
+    std::future<ErrorNumber> result = promise.get_future();
+    beginAsync();
+    std::thread([this, libPath, config, flags](std::promise<ErrorNumber> p) {
+            try {
+                p.set_value(loadLibrary(libPath, config, NULL, flags));
+            } catch(...) {
+                p.set_exception(std::current_exception());
+            }
+            endAsync();
+        }, std::move(promise)).detach();
+    return result;
+}
+
+/**
+ * Same as loadConfigFile(), but runs on a new thread, see
+ * loadLibraryAsync().
+ */
+std::future<void> LibManager::loadConfigFileAsync(const std::string &config_file)
+{
+    std::promise<void> promise;
+    std::future<void> result = promise.get_future();
+    beginAsync();
+    std::thread([this, config_file](std::promise<void> p) {
+            try {
+                loadConfigFile(config_file);
+                p.set_value();
+            } catch(...) {
+                p.set_exception(std::current_exception());
+            }
+            endAsync();
+        }, std::move(promise)).detach();
+    return result;
+}
+
+void LibManager::beginAsync()
+{
+    std::lock_guard<std::mutex> lock(asyncMutex);
+    ++asyncLoads;
+}
+
+/**
+ * Must be the last thing an asynchronous load does with the manager.
+ */
+void LibManager::endAsync()
+{
+    std::lock_guard<std::mutex> lock(asyncMutex);
+    --asyncLoads;
+    asyncDone.notify_all();
+}
+
+/**
+ * Registers a listener for the LoadEvents of all following loads. The
+ * listener must stay valid until it is removed again.
+ */
+void LibManager::addLoadListener(LoadListener *listener)
+{
+    std::lock_guard<std::recursive_mutex> lock(listenerMutex);
+    loadListeners.push_back(listener);
+}
+
+/**
+ * Removes a listener. When this returns, the listener is not called any
+ * more (unless removeLoadListener() is called from within loadEvent()).
+ */
+void LibManager::removeLoadListener(LoadListener *listener)
+{
+    std::lock_guard<std::recursive_mutex> lock(listenerMutex);
+    loadListeners.erase(std::remove(loadListeners.begin(),
+                                    loadListeners.end(), listener),
+                        loadListeners.end());
+}
+
+/**
+ * Sends all messages to sink instead of stderr. NULL selects stderr again.
+ * The sink must stay valid until it is replaced.
+ */
+void LibManager::setLogSink(LogSink *sink)
+{
+    logger->setSink(sink);
+}
+
+/**
+ * Only messages up to level are logged. The default is LIBMGR_LOG_INFO.
+ * Messages above LIB_MANAGER_MAX_LOG_LEVEL are not compiled in at all.
+ */
+void LibManager::setLogLevel(LogLevel level)
+{
+    logger->setLevel(level);
+}
+
+LibManager::LogLevel LibManager::getLogLevel() const
+{
+    return logger->getLevel();
+}
+
+/**
+ * Returns the details of the last call of the calling thread that failed
+ * to load or find a library.
+ */
+LibManager::ErrorInfo LibManager::getLastError()
+{
+    return lastError;
+}
+
+void LibManager::loadEvent(LoadEventType type, const MappedLib &lib,
+                           ErrorNumber error)
+{
+    std::lock_guard<std::recursive_mutex> lock(listenerMutex);
+    if(loadListeners.empty()) {
+        return;
+    }
+    LoadEvent event;
+    event.type = type;
+    event.libPath = lib.libPath;
+    event.filepath = lib.filepath;
+    event.libName = lib.libName;
+    event.error = error;
+    if(type == LIBMGR_EVENT_FAILED) {
+        event.detail = lib.errorDetail;
+    }
+    // a listener may add or remove listeners
+    std::vector<LoadListener*> listeners(loadListeners);
+    for(size_t i = 0; i < listeners.size(); ++i) {
+        listeners[i]->loadEvent(event);
+    }
+}
+
+/**
+ * Loads all libraries specified in a configuration file. The file is a text
+ * file with one library path or name per line; lines starting with # are
+ * ignored. A path can be followed by options, e.g.
+ * "my_plugin now global priority=2":
+ *   lazy, eager                  LIBMGR_LOAD_LAZY on or off
+ *   now, bindlazy                LIBMGR_LOAD_NOW on or off
+ *   global, local                LIBMGR_LOAD_GLOBAL on or off
+ *   nodelete, deepbind           LIBMGR_LOAD_NODELETE, LIBMGR_LOAD_DEEPBIND
+ *   locked                       LIBMGR_LOAD_LOCKED
+ *   priority=N                   load before libraries with a lower priority
+ *                                of the same dependency level (default 0)
+ *   depends=a,b                  load after the libraries with these names
+ *                                or paths, in addition to the dependencies
+ *                                known from the index
+ * A line "include other_file" reads the lines of other_file in its place;
+ * relative paths are relative to the including file.
+ *
+ * As in files written before there were options, a path can contain
+ * whitespace without quotes: only the options at the end of the line are
+ * taken as options, from the last word back to the first word that is not
+ * one. A path that itself ends in a word like "lazy" or "priority=2", or
+ * that starts with "include ", has to be put in double quotes; anything
+ * after the closing quote is then taken as options, and unknown ones are
+ * warned about.
+ *
+ * All files are read first and the whole list is then handed to
+ * loadLibraries() as one batch.
+ * @param config_file
+ */
+void LibManager::loadConfigFile(const std::string &config_file) 
+{
+    std::vector<ConfigEntry> entries;
+    ConfigParser parser(logger);
+    if(!parser.parse(config_file, defaultLoadFlags, &entries)) {
+        return;
+    }
+
+    std::vector<MappedLib> libs(entries.size());
+    for(size_t i = 0; i < entries.size(); ++i) {
+        libs[i].libPath.swap(entries[i].libPath);
+        libs[i].flags = entries[i].flags;
+        libs[i].priority = entries[i].priority;
+        libs[i].extraDependencies.swap(entries[i].dependencies);
+    }
+    loadBatch(&libs);
+}
+
+/**
+ * Loads a list of libraries. Libraries whose dependencies are known from the
+ * index are loaded after the libraries they depend on; otherwise the list
+ * order is kept (see getLoadOrder()).
+ *
+ * With a single load thread (the default) every library is mapped and
+ * constructed before the next one is looked at. With more threads all
+ * libraries of one dependency level are first mapped (dlopen/dlsym) in
+ * parallel; then their create_c functions are called and the instances are
+ * registered one after another in list order, so the newLibLoaded()
+ * notifications are deterministic.
+ * @param libPaths The paths or names of the libraries to load.
+ * @param flags If not NULL, the LoadFlags for every library. Otherwise the
+ *        default flags are used.
+ */
+void LibManager::loadLibraries(const std::vector<std::string> &libPaths,
+                               const std::vector<int> *flags)
+{
+    std::vector<MappedLib> libs(libPaths.size());
+    for(size_t i = 0; i < libs.size(); ++i) {
+        int libFlags = LIBMGR_LOAD_DEFAULTS;
+        if(flags && i < flags->size()) {
+            libFlags = (*flags)[i];
+        }
+        libs[i].libPath = libPaths[i];
+        libs[i].flags = (libFlags == LIBMGR_LOAD_DEFAULTS ? defaultLoadFlags :
+                         libFlags);
+    }
+    loadBatch(&libs);
+}
+
+/**
+ * Does the work of loadLibraries(). libPath, flags and the config file
+ * hints must be set in every MappedLib.
+ */
+void LibManager::loadBatch(std::vector<MappedLib> *batch)
+{
+    std::vector<MappedLib> &libs = *batch;
+    pathResolver->nextGeneration();
+
+    threadPool->parallelFor(libs.size(), numLoadThreads, [&](size_t i) {
+            const std::string libPath = libs[i].libPath;
+            locateLib(libPath, &libs[i]);
+        });
+    if(prefetch) {
+        prefetchLibs(libs);
+    }
+    std::vector<std::vector<size_t> > levels;
+    sortLibs(libs, &levels);
+
+    for(size_t l = 0; l < levels.size(); ++l) {
+        const std::vector<size_t> &level = levels[l];
+        if(numLoadThreads < 2) {
+            for(size_t i = 0; i < level.size(); ++i) {
+                loadMapped(&libs[level[i]], NULL, NULL, libs[level[i]].flags,
+                           false);
+            }
+            continue;
+        }
+
+        threadPool->parallelFor(level.size(), numLoadThreads, [&](size_t i) {
+                MappedLib &lib = libs[level[i]];
+                const bool lazy = (lib.flags & LIBMGR_LOAD_LAZY);
+                if(!lazy || !canDefer(lib)) {
+                    mapLib(&lib, false, lazy);
+                }
+            });
+        for(size_t i = 0; i < level.size(); ++i) {
+            loadMapped(&libs[level[i]], NULL, NULL, libs[level[i]].flags,
+                       true);
+        }
+    }
+}
+
+/**
+ * Warmup stage of loadBatch(): asks the OS to read all library files that
+ * are about to be mapped, before the first one is. The reads run in the
+ * background and in parallel, so mapping the libraries one by one then
+ * mostly finds their pages in memory instead of faulting them in from a
+ * slow disk. Lazily loaded libraries may never be mapped and are skipped.
+ * Enabled with setPrefetch().
+ */
+void LibManager::prefetchLibs(const std::vector<MappedLib> &libs)
+{
+    int64_t start = traceClock();
+    for(size_t i = 0; i < libs.size(); ++i) {
+        const MappedLib &lib = libs[i];
+        if(!lib.builtin && !(lib.flags & LIBMGR_LOAD_LAZY) &&
+           !lib.filepath.empty()) {
+            prefetchFile(lib.filepath);
+        }
+    }
+    loadTrace->record("prefetch", std::string(), start, traceClock() - start);
+}
+
+/**
+ * Computes the order in which loadLibraries() would load the given
+ * libraries. Every level only depends on earlier levels; the libraries
+ * within a level are independent of each other and could be loaded in
+ * parallel. Dependencies are taken from the library index, so libraries
+ * that were never loaded before all end up in the first level.
+ * @param libPaths The paths or names of the libraries.
+ * @param levels Receives the levels of paths.
+ */
+void LibManager::getLoadOrder(const std::vector<std::string> &libPaths,
+                              std::vector<std::vector<std::string> > *levels)
+{
+    std::vector<MappedLib> libs(libPaths.size());
+    for(size_t i = 0; i < libPaths.size(); ++i) {
+        locateLib(libPaths[i], &libs[i]);
+    }
+    std::vector<std::vector<size_t> > indexLevels;
+    sortLibs(libs, &indexLevels);
+    for(size_t l = 0; l < indexLevels.size(); ++l) {
+        levels->push_back(std::vector<std::string>());
+        for(size_t i = 0; i < indexLevels[l].size(); ++i) {
+            levels->back().push_back(libPaths[indexLevels[l][i]]);
+        }
+    }
+}
+
+/**
+ * Returns the library name a file name stands for, e.g. "foo" for
+ * "/path/libfoo.so".
+ */
+static std::string fileStem(const std::string &path)
+{
+    size_t start = path.find_last_of("/\\");
+    start = (start == string::npos ? 0 : start + 1);
+    if(path.compare(start, 3, "lib") == 0) {
+        start += 3;
+    }
+    size_t end = path.find('.', start);
+    return path.substr(start, end == string::npos ? string::npos : end - start);
+}
+
+/**
+ * Sorts located libraries into dependency levels. A dependency can name a
+ * library by its name, by the path it is loaded by or by the name of its
+ * file without "lib" and suffix. Within a level, libraries with a higher
+ * priority come first.
+ */
+void LibManager::sortLibs(const std::vector<MappedLib> &libs,
+                          std::vector<std::vector<size_t> > *levels) const
+{
+    std::unordered_map<std::string, size_t> nodes;
+    for(size_t i = 0; i < libs.size(); ++i) {
+        if(!libs[i].libName.empty()) {
+            nodes.insert(std::make_pair(libs[i].libName, i));
+        }
+    }
+    for(size_t i = 0; i < libs.size(); ++i) {
+        nodes.insert(std::make_pair(libs[i].libPath, i));
+    }
+    for(size_t i = 0; i < libs.size(); ++i) {
+        nodes.insert(std::make_pair(fileStem(libs[i].libPath), i));
+    }
+    std::vector<std::vector<size_t> > edges(libs.size());
+    for(size_t i = 0; i < libs.size(); ++i) {
+        const std::vector<std::string> *lists[2] = {
+            &libs[i].dependencies, &libs[i].extraDependencies };
+        for(size_t l = 0; l < 2; ++l) {
+            for(size_t d = 0; d < lists[l]->size(); ++d) {
+                std::unordered_map<std::string, size_t>::const_iterator it;
+                it = nodes.find((*lists[l])[d]);
+                if(it != nodes.end()) {
+                    edges[i].push_back(it->second);
+                }
+            }
+        }
+    }
+    if(!sortIntoLevels(edges, levels)) {
+        LIBMGR_LOG(logger, LIBMGR_LOG_WARNING, "LibManager: cyclic library "
+                   "dependencies, loading the rest in list order");
+    }
+    for(size_t l = 0; l < levels->size(); ++l) {
+        std::stable_sort((*levels)[l].begin(), (*levels)[l].end(),
+                         [&libs](size_t a, size_t b) {
+                             return libs[a].priority > libs[b].priority;
+                         });
+    }
+}
+
+/**
+ * Sets the number of threads loadLibraries() and loadConfigFile() use to map
+ * libraries. A value of 1 loads everything sequentially on the calling
+ * thread, 0 selects the number of hardware threads. Only mapping runs on
+ * these threads; constructors and destroy functions of the libraries stay
+ * on the calling thread (but see setNumDestroyThreads()). The threads are
+ * started here and kept until the manager is deleted.
+ * @param numThreads
+ */
+void LibManager::setNumLoadThreads(unsigned int numThreads)
+{
+    if(numThreads == 0) {
+        numThreads = std::thread::hardware_concurrency();
+        if(numThreads == 0) {
+            numThreads = 1;
+        }
+    }
+    numLoadThreads = numThreads;
+    threadPool->resize(std::max(numLoadThreads, numDestroyThreads));
+}
+
+/**
+ * Sets the number of threads that destroy unused libraries which do not
+ * depend on each other, in clearLibraries(), reloadLibraries(), when unused
+ * libraries are reclaimed and when the manager is deleted. The default of
+ * 1 runs every destroy function on the calling thread, 0 selects the
+ * number of hardware threads.
+ *
+ * Only set more than one if every library can be destroyed on any thread
+ * and concurrently with the others; many cannot, e.g. those that own GUI
+ * or OpenGL resources. Destroy functions may acquire and release other
+ * libraries; libraries they release the last reference of are unloaded
+ * after the pass. They must not load or unload libraries themselves.
+ * @param numThreads
+ */
+void LibManager::setNumDestroyThreads(unsigned int numThreads)
+{
+    if(numThreads == 0) {
+        numThreads = std::thread::hardware_concurrency();
+        if(numThreads == 0) {
+            numThreads = 1;
+        }
+    }
+    numDestroyThreads = numThreads;
+    threadPool->resize(std::max(numLoadThreads, numDestroyThreads));
+}
+
+/**
+ * Forgets which files the library names were resolved to. The next load
+ * searches the library search path again.
+ */
+void LibManager::clearPathCache()
+{
+    pathResolver->clear();
+}
+
+/**
+ * Accepts a pointer to a list of type LibInterface and appends pointers to 
+ * all registered libraries, acquiring each of them.
+ *
+ * Libraries that are registered lazily (see LIBMGR_LOAD_LAZY) and were not
+ * acquired yet have no instance, and are left out so that listing the
+ * libraries constructs nothing. getAllLibraryNames() still lists them.
+ * Code that relied on getting every registered library can pass
+ * constructPending; the pending libraries are then constructed and
+ * appended after the others.
+ * @param libList
+ * @param constructPending Whether to construct and include the pending
+ *        libraries.
+ */
+void LibManager::getAllLibraries(std::list<LibInterface*> *libList,
+                                 bool constructPending)
+{
+    std::vector<LibId> pending;
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        for(size_t i = 0; i < libSlots.size(); ++i) {
+            libStruct &theLib = libSlots[i];
+            if(theLib.libInterface && acquireRef(&theLib)) {
+                libList->push_back(theLib.libInterface);
+            } else if(constructPending && theLib.pending &&
+                      acquireRef(&theLib)) {
+                pending.push_back(LibId(i, theLib.generation));
+            }
+        }
+    }
+    for(size_t i = 0; i < pending.size(); ++i) {
+        LibInterface *lib = acquirePending(pending[i]);
+        if(lib) {
+            libList->push_back(lib);
+        }
+    }
+}
+
+/**
+ * Acquires all constructed libraries at once. Unlike getAllLibraries() the
+ * references are released together by dropping the snapshot, without a name
+ * lookup per library. Libraries that are registered lazily and were not
+ * acquired yet are left out, so taking a snapshot constructs nothing.
+ */
+LibSnapshot LibManager::snapshotLibraries()
+{
+    std::vector<LibSnapshot::Entry> *entries = new std::vector<LibSnapshot::Entry>;
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        entries->reserve(libSlots.size());
+        for(size_t i = 0; i < libSlots.size(); ++i) {
+            if(libSlots[i].libInterface && acquireRef(&libSlots[i])) {
+                LibSnapshot::Entry entry;
+                entry.id = LibId(i, libSlots[i].generation);
+                entry.lib = libSlots[i].libInterface;
+                entries->push_back(entry);
+            }
+        }
+    }
+    return LibSnapshot(this, entries);
+}
+
+/**
+ * Releases the references of a snapshot, like releaseLibrary(LibId) for
+ * every entry but with a single pass over the table. Unused libraries are
+ * reclaimed as set by setReclaimMode().
+ */
+void LibManager::releaseSnapshot(const std::vector<LibSnapshot::Entry> &entries)
+{
+    std::vector<LibId> unused;
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        for(size_t i = 0; i < entries.size(); ++i) {
+            libStruct *theLib = getLib(entries[i].id);
+            if(!theLib) {
+                continue;
+            }
+            theLib->releases.fetch_add(1, std::memory_order_relaxed);
+            trackRelease(theLib, theLib->useCount);
+            if(--theLib->useCount == 0) {
+                unused.push_back(entries[i].id);
+            }
+        }
+    }
+    reclaimUnused(unused);
+}
+
+LibSnapshot::LibSnapshot(LibManager *manager, std::vector<Entry> *theEntries)
+    : entries(theEntries, [manager](const std::vector<Entry> *theEntries) {
+            manager->releaseSnapshot(*theEntries);
+            delete theEntries;
+        })
+{
+}
+
+/**
+ * Accepts a pointer to a string list and appends the names of the registered libraries.
+ * @param libNameList A pointer to a list of strings.
+ */
+void LibManager::getAllLibraryNames(std::list<std::string> *libNameList) const 
+{
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    for(size_t i = 0; i < libSlots.size(); ++i) {
+        if(libSlots[i].isRegistered()) {
+            libNameList->push_back(libSlots[i].name);
+        }
+    }
+}
+
+static void fillLibView(const libStruct &theLib, uint32_t index,
+                        LibManager::LibView *view)
+{
+    view->id = LibId(index, theLib.generation);
+    view->name = theLib.name;
+    view->path = theLib.path;
+    view->version = theLib.version;
+    view->src = theLib.src;
+    view->revision = theLib.revision;
+    view->references = theLib.useCount;
+}
+
+/**
+ * Calls visitor->visit() for every registered library. Unlike
+ * getLibraryInfo() and getAllLibraryNames() this copies nothing, so that
+ * the libraries can be polled often.
+ */
+void LibManager::visitLibraries(LibVisitor *visitor) const
+{
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    LibView view;
+    for(size_t i = 0; i < libSlots.size(); ++i) {
+        if(libSlots[i].isRegistered()) {
+            fillLibView(libSlots[i], i, &view);
+            visitor->visit(view);
+        }
+    }
+}
+
+/**
+ * Calls visitor->visit() for the library libName, like visitLibraries().
+ * @return false if there is no such library.
+ */
+bool LibManager::visitLibrary(const std::string &libName,
+                              LibVisitor *visitor) const
+{
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    uint32_t index;
+    const libStruct *theLib = findLib(libName, &index);
+    if(!theLib) {
+        return false;
+    }
+    LibView view;
+    fillLibView(*theLib, index, &view);
+    visitor->visit(view);
+    return true;
+}
+
+/**
+ * Returns the statistics of a library, also if it was unloaded again.
+ * All values are 0 for unknown libraries.
+ */
+LibStats LibManager::getLibraryStats(const std::string &libName) const
+{
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    const libStruct *theLib = findLib(libName);
+    if(theLib) {
+        LibInfo info;
+        fillLibInfo(*theLib, &info);
+        return info.stats;
+    }
+    std::lock_guard<std::mutex> statsLock(statsMutex);
+    std::unordered_map<std::string, LibStats>::const_iterator it;
+    it = libStats.find(libName);
+    return it != libStats.end() ? it->second : LibStats();
+}
+
+/**
+ * Turns reference tracking on or off. While it is on, every reference taken
+ * with acquireLibrary() and friends is recorded together with the
+ * setAcquireTag() of the acquiring thread until it is released, and the
+ * acquire and release rates, hold times and the time spent waiting for the
+ * table lock are counted in histograms. See getLibraryTelemetry(); dumpTo()
+ * adds a telemetry section and the destructor names the holders of leaked
+ * references. Turning it off drops everything recorded.
+ *
+ * Tracking costs a lock and an allocation per acquire and is meant for
+ * finding leaked references and contention, not for production use.
+ *
+ * @param backtraceEvery If not 0, the call stack is recorded for every
+ *        backtraceEvery-th acquire. Only supported with glibc and on macOS.
+ */
+void LibManager::setRefTracking(bool enable, unsigned int backtraceEvery)
+{
+    refTracker->setEnabled(enable, backtraceEvery);
+}
+
+bool LibManager::getRefTracking() const
+{
+    return refTracker->isEnabled();
+}
+
+/**
+ * Sets the tag recorded with the references the calling thread acquires
+ * while reference tracking is on, e.g. the name of the subsystem. The
+ * string must stay valid, best use a literal. NULL is the same as "".
+ */
+void LibManager::setAcquireTag(const char *tag)
+{
+    RefTracker::setTag(tag);
+}
+
+/**
+ * Returns what reference tracking recorded for a loaded library. Returns
+ * false if tracking is off or nothing was recorded for the library yet.
+ */
+bool LibManager::getLibraryTelemetry(const std::string &libName,
+                                     LibTelemetry *telemetry) const
+{
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    uint32_t index;
+    if(!refTracker->isEnabled() || !findLib(libName, &index)) {
+        return false;
+    }
+    return refTracker->get(index, telemetry);
+}
+
+/**
+ * Starts or stops recording the load steps (resolve, dlopen, symbols,
+ * create, newLibLoaded, destroy) of all libraries for writeTrace().
+ */
+void LibManager::setTracing(bool enable)
+{
+    loadTrace->setEnabled(enable);
+}
+
+/**
+ * Writes the recorded load steps as Chrome trace event JSON, which can be
+ * opened in chrome://tracing or Perfetto.
+ */
+bool LibManager::writeTrace(const std::string &filename) const
+{
+    if(!loadTrace->write(filename)) {
+        LIBMGR_LOG(logger, LIBMGR_LOG_ERROR, "LibManager: cannot write "
+                   "trace \"%s\".", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+void LibManager::clearTrace()
+{
+    loadTrace->clear();
+}
+
+/**
+ * Accepts a constant string and returns a LibInfo struct.
+ * @param libName
+ * @return 
+ */
+LibInfo LibManager::getLibraryInfo(const std::string &libName) const 
+{
+    LibInfo info;
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    const libStruct *theLib = findLib(libName);
+    if(theLib) {
+        fillLibInfo(*theLib, &info);
+    }
+    return info;
+}
+
+/**
+ * Writes the names, source and revision of all registered libraries to the specified file.
+ * @param filepath The path of the file where the names should be dumped.
+ * @return false if the file cannot be written.
+ */
+bool LibManager::dumpTo(const std::string &filepath, DumpFormat format) const
+{
+    FILE *file = fopen(filepath.c_str(),
+                       format == LIBMGR_DUMP_BINARY ? "wb" : "w");
+    if(!file) {
+        LIBMGR_LOG(logger, LIBMGR_LOG_ERROR, "LibManager::dumpTo: cannot "
+                   "open \"%s\".", filepath.c_str());
+        return false;
+    }
+    bool ok = dumpTo(file, format);
+    ok = (fclose(file) == 0) && ok;
+    if(!ok) {
+        LIBMGR_LOG(logger, LIBMGR_LOG_ERROR, "LibManager::dumpTo: cannot "
+                   "write \"%s\".", filepath.c_str());
+    }
+    return ok;
+}
+
+/**
+ * Same as dumpTo(const std::string&), but writes to an open file, which
+ * is flushed but not closed.
+ */
+bool LibManager::dumpTo(FILE *file, DumpFormat format) const
+{
+    DumpWriter writer(format, file);
+    return dumpModules(&writer);
+}
+
+/**
+ * Same as dumpTo(const std::string&), but writes to a file descriptor,
+ * which stays open.
+ */
+bool LibManager::dumpTo(int fd, DumpFormat format) const
+{
+    DumpWriter writer(format, fd);
+    return dumpModules(&writer);
+}
+
+/**
+ * Same as dumpTo(const std::string&), but appends to buffer.
+ */
+bool LibManager::dumpTo(std::string *buffer, DumpFormat format) const
+{
+    DumpWriter writer(format, buffer);
+    return dumpModules(&writer);
+}
+
+/**
+ * Streams all registered libraries and the C++ standard library to writer
+ * in a single pass over the table. The table stays locked shared while
+ * writing, which only holds up loading and unloading.
+ */
+bool LibManager::dumpModules(DumpWriter *writer) const
+{
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    uint32_t numModules = 1;
+    for(size_t i = 0; i < libSlots.size(); ++i) {
+        if(libSlots[i].isRegistered()) {
+            ++numModules;
+        }
+    }
+    writer->begin(numModules);
+    for(size_t i = 0; i < libSlots.size(); ++i) {
+        const libStruct &theLib = libSlots[i];
+        if(theLib.isRegistered()) {
+            writer->module(theLib.name, theLib.src, theLib.version,
+                           theLib.revision, false);
+        }
+    }
+    writer->module(stdlibInfo.name, stdlibInfo.src, stdlibInfo.version,
+                   stdlibInfo.revision, true);
+    if(refTracker->isEnabled()) {
+        std::vector<uint32_t> tracked;
+        std::vector<LibTelemetry> telemetry(libSlots.size());
+        for(size_t i = 0; i < libSlots.size(); ++i) {
+            if(libSlots[i].isRegistered() &&
+               refTracker->get(i, &telemetry[i])) {
+                tracked.push_back(i);
+            }
+        }
+        writer->beginTelemetry(tracked.size());
+        for(size_t t = 0; t < tracked.size(); ++t) {
+            const libStruct &theLib = libSlots[tracked[t]];
+            writer->telemetry(theLib.name, theLib.useCount,
+                              telemetry[tracked[t]]);
+        }
+    }
+    return writer->end();
+}
+
+/**
+ * Returns the libStruct registered under libName, or NULL. This is a single
+ * hash lookup. If index is not NULL, it receives the slot index. Must be
+ * called with the table lock held.
+ */
+libStruct* LibManager::findLib(const std::string &libName, uint32_t *index)
+{
+    std::unordered_map<std::string_view, uint32_t>::const_iterator it;
+    it = libNames.find(libName);
+    if(it == libNames.end()) {
+        return NULL;
+    }
+    if(index) {
+        *index = it->second;
+    }
+    return &libSlots[it->second];
+}
+
+const libStruct* LibManager::findLib(const std::string &libName,
+                                     uint32_t *index) const
+{
+    std::unordered_map<std::string_view, uint32_t>::const_iterator it;
+    it = libNames.find(libName);
+    if(it == libNames.end()) {
+        return NULL;
+    }
+    if(index) {
+        *index = it->second;
+    }
+    return &libSlots[it->second];
+}
+
+/**
+ * Returns the libStruct id refers to, or NULL if id is no longer valid.
+ * Must be called with the table lock held.
+ */
+libStruct* LibManager::getLib(LibId id)
+{
+    if(id.index >= libSlots.size()) {
+        return NULL;
+    }
+    libStruct *theLib = &libSlots[id.index];
+    if(!theLib->isRegistered() || theLib->generation != id.generation) {
+        return NULL;
+    }
+    return theLib;
+}
+
+/**
+ * Returns the index of an unused slot, creating one if needed. Must be
+ * called with the table lock held exclusively.
+ */
+uint32_t LibManager::claimSlot()
+{
+    if(freeSlots.empty()) {
+        uint32_t index = libSlots.grow();
+        libSlots[index].generation = firstGeneration;
+        libSlots[index].index = index;
+        return index;
+    }
+    uint32_t index = freeSlots.back();
+    freeSlots.pop_back();
+    return index;
+}
+
+/**
+ * Removes the library from the name lookup and puts its slot on the free
+ * list. Does not destroy the library. Must be called with the table lock
+ * held exclusively.
+ */
+void LibManager::freeLib(libStruct *theLib)
+{
+    uint32_t index = theLib->index;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        LibStats &stats = libStats[theLib->name];
+        stats.acquires += theLib->acquires.exchange(0);
+        stats.releases += theLib->releases.exchange(0);
+    }
+    removeSubscriptions(index);
+    unindexInterfaces(index);
+    if(refTracker->isEnabled()) {
+        refTracker->forget(index);
+    }
+    libNames.erase(theLib->name);
+    theLib->libInterface = NULL;
+    theLib->destroy = NULL;
+    theLib->pending = false;
+    theLib->create = NULL;
+    theLib->filepath.clear();
+    theLib->version = 0;
+    theLib->src.clear();
+    theLib->revision.clear();
+    theLib->loadFlags = 0;
+    theLib->handle = NULL;
+    theLib->useCount = 0;
+    theLib->path.clear();
+    theLib->name.clear();
+    theLib->dependencies.clear();
+    theLib->subscriptions.clear();
+    theLib->casts.clear();
+    theLib->notifyAll = true;
+    theLib->generation++;
+    freeSlots.push_back(index);
+}
+
+/**
+ * Enters the subscriptions of the slot into the subscription index. Must be
+ * called with the table lock held exclusively.
+ */
+void LibManager::addSubscriptions(uint32_t index)
+{
+    const libStruct &theLib = libSlots[index];
+    if(theLib.notifyAll) {
+        allSubscribers.push_back(index);
+        return;
+    }
+    for(size_t i = 0; i < theLib.subscriptions.size(); ++i) {
+        libSubscribers[theLib.subscriptions[i]].push_back(index);
+    }
+}
+
+/**
+ * Removes the subscriptions of the slot from the subscription index. Must be
+ * called with the table lock held exclusively.
+ */
+void LibManager::removeSubscriptions(uint32_t index)
+{
+    const libStruct &theLib = libSlots[index];
+    if(theLib.notifyAll) {
+        allSubscribers.erase(std::remove(allSubscribers.begin(),
+                                         allSubscribers.end(), index),
+                             allSubscribers.end());
+        return;
+    }
+    for(size_t i = 0; i < theLib.subscriptions.size(); ++i) {
+        std::unordered_map<std::string, std::vector<uint32_t> >::iterator it;
+        it = libSubscribers.find(theLib.subscriptions[i]);
+        if(it == libSubscribers.end()) {
+            continue;
+        }
+        it->second.erase(std::remove(it->second.begin(), it->second.end(),
+                                     index),
+                         it->second.end());
+        if(it->second.empty()) {
+            libSubscribers.erase(it);
+        }
+    }
+}
+
+/**
+ * Fills info from a registered library. Must be called with the table lock
+ * held.
+ */
+void LibManager::fillLibInfo(const libStruct &theLib, LibInfo *info) const
+{
+    info->name = theLib.name;
+    info->path = theLib.path;
+    info->references = theLib.useCount;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        std::unordered_map<std::string, LibStats>::const_iterator it;
+        it = libStats.find(theLib.name);
+        info->stats = it != libStats.end() ? it->second : LibStats();
+    }
+    info->stats.acquires += theLib.acquires;
+    info->stats.releases += theLib.releases;
+    info->version = theLib.version;
+    info->src = theLib.src;
+    info->revision = theLib.revision;
+}
+
+/**
+ * Stores the version and module info of a constructed library in its
+ * libStruct, so that queries do not have to call into the library.
+ */
+void LibManager::cacheModuleInfo(const LibInterface *lib, libStruct *theLib)
+{
+    ModuleInfo modInfo = lib->getModuleInfo();
+    theLib->version = lib->getLibVersion();
+    theLib->src = modInfo.src;
+    theLib->revision = modInfo.revision;
+}
+
+/**
+ * Destroys the library id refers to if it is no longer referenced.
+ */
+LibManager::ErrorNumber LibManager::unloadLib(LibId id)
+{
+    std::lock_guard<std::recursive_mutex> loadLock(loadMutex);
+    libStruct oldLib;
+    {
+        std::unique_lock<std::shared_mutex> lock(tableMutex);
+        libStruct *theLib = getLib(id);
+        if(!theLib) {
+            return LIBMGR_ERR_NO_LIBRARY;
+        }
+        if(theLib->useCount < 0)
+        {
+            throw std::runtime_error("Internal error, use count is below zero !");
+        }
+        if(theLib->useCount != 0) {
+            return LIBMGR_ERR_LIB_IN_USE;
+        }
+        oldLib = *theLib;
+        freeLib(theLib);
+    }
+
+    LIBMGR_LOG(logger, LIBMGR_LOG_INFO, "LibManager: unload delete [%s]",
+               oldLib.name.c_str());
+    destroyInstance(oldLib);
+    unrefHandle(oldLib.handle);
+    return LIBMGR_NO_ERROR;
+}
+
+/**
+ * Calls the destroy function of a library that is no longer in the table,
+ * and times it.
+ */
+void LibManager::destroyInstance(const libStruct &theLib)
+{
+    if(!theLib.libInterface || !theLib.destroy) {
+        return;
+    }
+    int64_t start = traceClock();
+    theLib.destroy(theLib.libInterface);
+    int64_t duration = traceClock() - start;
+    loadTrace->record("destroy", theLib.name, start, duration);
+    std::lock_guard<std::mutex> lock(statsMutex);
+    libStats[theLib.name].destroyTime = duration;
+}
+
+/**
+ * Stores the load step durations of lib as the LibStats of name. Steps that
+ * did not run this time (duration 0) keep their earlier value.
+ */
+void LibManager::recordLoadStats(const std::string &name, const MappedLib &lib,
+                                 int64_t createTime)
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    LibStats &stats = libStats[name];
+    if(lib.resolveTime) {
+        stats.resolveTime = lib.resolveTime;
+    }
+    if(lib.mapTime) {
+        stats.mapTime = lib.mapTime;
+    }
+    if(lib.symbolTime) {
+        stats.symbolTime = lib.symbolTime;
+    }
+    if(createTime) {
+        stats.createTime = createTime;
+    }
+}
+
+/**
+ * Takes over the OS loader reference of a freshly mapped handle for a new
+ * libStruct. If the file is already used by another libStruct, the extra
+ * reference is dropped again, so that every known handle holds exactly one.
+ * Returns the handle.
+ */
+void* LibManager::refHandle(void *handle)
+{
+    if(!handle) {
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(handleMutex);
+    if(handleRefs[handle]++ > 0) {
+        closeHandle(handle);
+    }
+    return handle;
+}
+
+/**
+ * Drops the reference of a libStruct to its handle and unmaps the library
+ * file together with the last one. Must only be called after the library
+ * instance is destroyed.
+ */
+void LibManager::unrefHandle(void *handle)
+{
+    if(!handle) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(handleMutex);
+        std::unordered_map<void*, int>::iterator it = handleRefs.find(handle);
+        if(it == handleRefs.end() || --it->second > 0) {
+            return;
+        }
+        handleRefs.erase(it);
+    }
+    closeHandle(handle);
+}
+
+/**
+ * Drops one OS loader reference to handle.
+ */
+void LibManager::closeHandle(void *handle)
+{
+    string error;
+    if(!intern_closeLib(static_cast<LibHandle>(handle), &error)) {
+        LIBMGR_LOG(logger, LIBMGR_LOG_ERROR, "ERROR: lib_manager cannot "
+                   "unload library:\n       %s", error.c_str());
+    }
+}
+
+    ////////////////////
     // Helper Functions
     ////////////////////
 
@@ -460,24 +3113,51 @@ static std::string getErrorStr()
     return errorMsg;
 }
 
-static LibHandle intern_loadLib(const std::string &libPath) 
+static LibHandle intern_loadLib(const std::string &libPath, int flags,
+                                string *error) 
 {
     LibHandle libHandle;
 #ifdef WIN32
+    // LoadLibrary always binds at load time and has no symbol scopes
+    (void)flags;
     libHandle = LoadLibrary(libPath.c_str());
 #else
-    libHandle = dlopen(libPath.c_str(), RTLD_LAZY);
+    int mode = (flags & LibManager::LIBMGR_LOAD_NOW) ? RTLD_NOW : RTLD_LAZY;
+    mode |= (flags & LibManager::LIBMGR_LOAD_GLOBAL) ? RTLD_GLOBAL : RTLD_LOCAL;
+    if(flags & LibManager::LIBMGR_LOAD_NODELETE) {
+        mode |= RTLD_NODELETE;
+    }
+#  ifdef RTLD_DEEPBIND
+    if(flags & LibManager::LIBMGR_LOAD_DEEPBIND) {
+        mode |= RTLD_DEEPBIND;
+    }
+#  endif
+    libHandle = dlopen(libPath.c_str(), mode);
 #endif
-    if(!libHandle) {
-    string errorMsg = getErrorStr();
-    fprintf(stderr, "ERROR: lib_manager cannot load library:\n       %s\n",
-            errorMsg.c_str());
+    if(!libHandle && error) {
+        *error = getErrorStr();
     }
     return libHandle;
 }
 
+static bool intern_closeLib(LibHandle libHandle, string *error)
+{
+    if(!libHandle) {
+        return true;
+    }
+#ifdef WIN32
+    bool failed = !FreeLibrary(libHandle);
+#else
+    bool failed = dlclose(libHandle) != 0;
+#endif
+    if(failed && error) {
+        *error = getErrorStr();
+    }
+    return !failed;
+}
+
 template <typename T>
-static T getFunc(LibHandle libHandle, const std::string &name) 
+static T getFunc(LibHandle libHandle, const std::string &name, string *error) 
 {
     T func = NULL;
 #ifdef WIN32
@@ -485,11 +3165,8 @@ static T getFunc(LibHandle libHandle, const std::string &name)
 #else
     func = reinterpret_cast<T>(dlsym(libHandle, name.c_str()));
 #endif
-    if(!func) {
-        string err = getErrorStr();
-        fprintf(stderr, 
-                "ERROR: lib_manager cannot load library symbol \"%s\"\n"
-                "       %s\n", name.c_str(), err.c_str());
+    if(!func && error) {
+        *error = getErrorStr();
     }
     return func;
 }
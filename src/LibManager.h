@@ -30,28 +30,229 @@
 #define LIB_MANAGER_H
 
 #include "LibInterface.h"
+#include "SlabPool.h"
 
-#include <map>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <future>
 #include <string>
+#include <string_view>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
 
 
 namespace lib_manager {
+
+    class PathResolver;
+    class LibIndex;
+    class LibWatcher;
+    class Logger;
+    class LoadTrace;
+    class Reclaimer;
+    class RefTracker;
+    class ThreadPool;
+    class DumpWriter;
+    struct MappedLib;
+    template <typename T> class LibPtr;
     
     struct libStruct {
-        libStruct() :libInterface(NULL), destroy(NULL), useCount(0)
+        libStruct() :libInterface(NULL), destroy(NULL), useCount(0),
+                     generation(0), notifyAll(true), pending(false),
+                     create(NULL), version(0), loadFlags(0), handle(NULL),
+                     acquires(0), releases(0), index(0)
         {
         };
 
-        libStruct(LibInterface *i) : libInterface(i), destroy(NULL), useCount(1)
+        libStruct(LibInterface *i) : libInterface(i), destroy(NULL), useCount(1),
+                                     generation(0), notifyAll(true),
+                                     pending(false), create(NULL), version(0),
+                                     loadFlags(0), handle(NULL), acquires(0),
+                                     releases(0), index(0)
         {}; 
+
+        libStruct(const libStruct &other)
+        { *this = other; }
+
+        libStruct& operator=(const libStruct &other) {
+            libInterface = other.libInterface;
+            destroy = other.destroy;
+            useCount = other.useCount.load();
+            path = other.path;
+            name = other.name;
+            generation = other.generation;
+            dependencies = other.dependencies;
+            notifyAll = other.notifyAll;
+            subscriptions = other.subscriptions;
+            pending = other.pending;
+            filepath = other.filepath;
+            create = other.create;
+            version = other.version;
+            src = other.src;
+            revision = other.revision;
+            loadFlags = other.loadFlags;
+            handle = other.handle;
+            acquires = other.acquires.load();
+            releases = other.releases.load();
+            casts = other.casts;
+            index = other.index;
+            return *this;
+        }
+
+        /// True if the slot holds a library, constructed or not.
+        bool isRegistered() const
+        { return libInterface != NULL || pending; }
         
         LibInterface *libInterface;
         destroyLib *destroy;
-        int useCount;
+        /// Once this drops to zero the library is unloaded and cannot be
+        /// acquired again.
+        std::atomic<int> useCount;
         std::string path;
+        std::string name;
+        /// Incremented whenever the slot is freed; invalidates old LibIds.
+        uint32_t generation;
+        /// See DependencyInterface::getDependencies().
+        std::vector<std::string> dependencies;
+        /// False if newLibLoaded() is only called for subscriptions.
+        bool notifyAll;
+        std::vector<std::string> subscriptions;
+        /**
+         * True while a lazily loaded library is registered but not yet
+         * constructed. Then filepath, create (if already mapped) and
+         * version (if known from the index) describe it.
+         */
+        bool pending;
+        std::string filepath;
+        createLib *create;
+        /**
+         * getLibVersion() and getModuleInfo(), cached when the library is
+         * constructed. For pending libraries the version is only known if
+         * it was in the index.
+         */
+        int version;
+        std::string src;
+        std::string revision;
+        /// The LoadFlags the library was loaded with.
+        int loadFlags;
+        /**
+         * The OS handle of the library file (see LibManager::refHandle()),
+         * NULL for libraries registered with addLibrary().
+         */
+        void *handle;
+        /// Counters for LibStats, only counted while the library is loaded.
+        std::atomic<uint64_t> acquires;
+        std::atomic<uint64_t> releases;
+        /**
+         * Results of casting the constructed library to interface types,
+         * NULL where it does not implement the type. See
+         * LibManager::lookupCast().
+         */
+        std::vector<std::pair<std::type_index, void*> > casts;
+        /// Position of the slot in LibManager::libSlots.
+        uint32_t index;
+    };
+
+    /**
+     * Identifies a registered library without a name lookup. A LibId is
+     * returned by addLibrary(), loadLibrary() and getLibraryId(). It
+     * becomes invalid when the library is unloaded, even if another library
+     * later takes its place.
+     */
+    struct LibId {
+        LibId() : index(UINT32_MAX), generation(0) {}
+        LibId(uint32_t i, uint32_t g) : index(i), generation(g) {}
+
+        bool isValid() const
+        { return index != UINT32_MAX; }
+        bool operator==(const LibId &other) const
+        { return index == other.index && generation == other.generation; }
+        bool operator!=(const LibId &other) const
+        { return !(*this == other); }
+
+        uint32_t index;
+        uint32_t generation;
     };
     
+    /**
+     * Where the time went when a library was loaded the last time, in
+     * nanoseconds, and how often it was used. The statistics of a library
+     * are kept by name and survive unloading and reloading it.
+     */
+    struct LibStats {
+        LibStats() : resolveTime(0), mapTime(0), symbolTime(0), createTime(0),
+                     notifyTime(0), destroyTime(0), acquires(0), releases(0)
+        {}
+
+        /// Finding the file (search path or index).
+        int64_t resolveTime;
+        /// dlopen() or LoadLibrary().
+        int64_t mapTime;
+        /// Looking up the factory functions.
+        int64_t symbolTime;
+        /// create_c() or config_create_c().
+        int64_t createTime;
+        /// Calling newLibLoaded() on the other libraries.
+        int64_t notifyTime;
+        /// destroy_c(), from the last unload.
+        int64_t destroyTime;
+        /// Successful acquireLibrary() and releaseLibrary() calls, in total.
+        uint64_t acquires;
+        uint64_t releases;
+    };
+
+    /**
+     * Counts values by their order of magnitude: buckets[0] counts 0 and 1,
+     * buckets[i] the values from 2^i to 2^(i+1)-1.
+     */
+    struct Histogram {
+        enum { NUM_BUCKETS = 40 };
+        Histogram()
+        { for(int i = 0; i < NUM_BUCKETS; ++i) buckets[i] = 0; }
+
+        uint64_t buckets[NUM_BUCKETS];
+    };
+
+    /// One reference taken while reference tracking was on.
+    struct RefHolder {
+        RefHolder() : age(0) {}
+
+        /// The LibManager::setAcquireTag() of the acquiring thread.
+        std::string tag;
+        /// Nanoseconds since the reference was taken.
+        int64_t age;
+        /// Return addresses of the acquiring call stack, innermost first,
+        /// if this acquire was sampled (see LibManager::setRefTracking()).
+        std::vector<void*> frames;
+    };
+
+    /**
+     * What reference tracking found out about a loaded library, see
+     * LibManager::setRefTracking(). Everything but the holders only counts
+     * calls made while tracking was on.
+     */
+    struct LibTelemetry {
+        /// The tracked references that are still held. References taken
+        /// before tracking was turned on, and the one of the loader, are
+        /// not in here.
+        std::vector<RefHolder> holders;
+        /// Nanoseconds acquireLibrary() and releaseLibrary() waited for
+        /// the table lock.
+        Histogram lockWait;
+        /// Nanoseconds from acquiring a tracked reference to releasing it.
+        Histogram holdTime;
+        /// Acquires and releases per second, one value for every second
+        /// in which there were any, the current one included.
+        Histogram acquireRate;
+        Histogram releaseRate;
+    };
+
     struct LibInfo {
         std::string name;
         std::string path;
@@ -59,8 +260,68 @@ namespace lib_manager {
         std::string src;
         std::string revision;
         int references;
+        LibStats stats;
     };
+
+    /// Result of LibManager::clearLibraries().
+    struct ClearReport {
+        /// Names of the libraries that were destroyed, in destruction order.
+        std::vector<std::string> destroyed;
+        /// Libraries that are still registered because they are referenced.
+        std::vector<LibInfo> leaked;
+    };
+
+    /**
+     * The constructed libraries at one point in time, returned by
+     * LibManager::snapshotLibraries(). The snapshot holds one reference to
+     * each library, so none of them is unloaded while it exists, no matter
+     * what other threads load or release in the meantime.
+     *
+     * The entries are stored contiguously and can be iterated without any
+     * lookup or allocation. Copies share the references; they are released
+     * in one pass when the last copy is destroyed or reset.
+     */
+    class LibSnapshot {
+    public:
+        struct Entry {
+            LibId id;
+            LibInterface *lib;
+        };
+
+        LibSnapshot() {}
+
+        const Entry* begin() const
+        { return entries ? entries->data() : NULL; }
+        const Entry* end() const
+        { return entries ? entries->data() + entries->size() : NULL; }
+        size_t size() const
+        { return entries ? entries->size() : 0; }
+        bool empty() const
+        { return size() == 0; }
+        const Entry& operator[](size_t i) const
+        { return (*entries)[i]; }
+
+        /// Drops this copy; the references are released with the last one.
+        void reset()
+        { entries.reset(); }
+
+    private:
+        friend class LibManager;
+
+        LibSnapshot(LibManager *manager, std::vector<Entry> *theEntries);
+
+        std::shared_ptr<const std::vector<Entry> > entries;
+    }; // class LibSnapshot
     
+    /**
+     * All methods may be called from several threads at once. Acquires and
+     * releases do not exclude each other: they only hold the library table
+     * shared, so they wait just while a load, registration or unload
+     * briefly changes the table. Acquiring a lazily registered library for
+     * the first time constructs it under the load lock, and releasing a
+     * last reference destroys the library as set by setReclaimMode().
+     * Loading, registering and unloading are serialized among themselves.
+     */
     class LibManager {
         
     public:
@@ -72,51 +333,591 @@ namespace lib_manager {
             LIBMGR_ERR_LIB_IN_USE,
             LIBMGR_NUM_ERRORS, //Do not use, must allways be the last entry
         };
+
+        /// Descriptions of the ErrorNumbers.
+        static constexpr const char *errorStrings[LIBMGR_NUM_ERRORS] = {
+            "no error",
+            "no library with given name loaded",
+            "library name already exists",
+            "not able to load library",
+            "library is still in use",
+        };
+
+        /// Details of a failed call, see getLastError().
+        struct ErrorInfo {
+            ErrorInfo() : error(LIBMGR_NO_ERROR) {}
+
+            ErrorNumber error;
+            /// The library the call was about.
+            std::string libPath;
+            /// What the system said, e.g. the text of dlerror().
+            std::string detail;
+        };
+
+        enum LogLevel {
+            LIBMGR_LOG_ERROR = 0,
+            LIBMGR_LOG_WARNING,
+            LIBMGR_LOG_INFO,
+            LIBMGR_LOG_DEBUG,
+        };
+
+        /**
+         * Receives the messages of the LibManager, see setLogSink(). log()
+         * is never called by two threads at once. message has no trailing
+         * newline.
+         */
+        class LogSink {
+        public:
+            virtual ~LogSink() {}
+            virtual void log(LogLevel level, const char *message) = 0;
+        };
+
+        /// Flags for loadLibrary() and setDefaultLoadFlags().
+        enum LoadFlags {
+            /// Use the flags set with setDefaultLoadFlags().
+            LIBMGR_LOAD_DEFAULTS = -1,
+            LIBMGR_LOAD_EAGER = 0,
+            /**
+             * Only register the library; it is mapped and constructed on
+             * the first acquireLibrary(). Needs the library name, which is
+             * taken from the library index or from the lib_name_c symbol
+             * (see DECLARE_LIB_NAME). Otherwise, and when a configuration
+             * is passed, the library is loaded eagerly.
+             */
+            LIBMGR_LOAD_LAZY = 1 << 0,
+            /**
+             * The following flags choose how the library file is mapped.
+             * By default symbols are bound lazily (RTLD_LAZY) and are not
+             * available to other libraries (RTLD_LOCAL).
+             */
+            /// Bind all symbols while mapping (RTLD_NOW).
+            LIBMGR_LOAD_NOW = 1 << 1,
+            /// Make the symbols available to libraries mapped later
+            /// (RTLD_GLOBAL).
+            LIBMGR_LOAD_GLOBAL = 1 << 2,
+            /// Never unmap the library (RTLD_NODELETE).
+            LIBMGR_LOAD_NODELETE = 1 << 3,
+            /// Prefer the library's own symbols over global ones
+            /// (RTLD_DEEPBIND, glibc only).
+            LIBMGR_LOAD_DEEPBIND = 1 << 4,
+            /**
+             * Fault in the whole library after mapping it and lock it in
+             * memory (mlock/VirtualLock), for real time code that must not
+             * page. Needs a large enough RLIMIT_MEMLOCK; if locking fails
+             * the library is loaded anyway and a warning is logged.
+             */
+            LIBMGR_LOAD_LOCKED = 1 << 5,
+        };
+
+        /// The steps a library goes through while it is loaded.
+        enum LoadEventType {
+            /// The file of the library was found (or left to the linker).
+            LIBMGR_EVENT_RESOLVED,
+            /// The file was mapped and the factory functions were found.
+            LIBMGR_EVENT_MAPPED,
+            /// The instance was created.
+            LIBMGR_EVENT_CONSTRUCTED,
+            /// The library was entered into the table (or registered lazily).
+            LIBMGR_EVENT_REGISTERED,
+            /// Loading stopped; LoadEvent::error tells why.
+            LIBMGR_EVENT_FAILED,
+        };
+
+        struct LoadEvent {
+            LoadEventType type;
+            /// The path or name the library is loaded by.
+            std::string libPath;
+            /// The resolved file.
+            std::string filepath;
+            /// The library name, if already known.
+            std::string libName;
+            ErrorNumber error;
+            /// For failures, what the system said (e.g. dlerror()).
+            std::string detail;
+        };
+
+        /**
+         * Receives LoadEvents, see addLoadListener(). loadEvent() may be
+         * called from several load threads at once, though never
+         * concurrently for the same manager and listener, and should return
+         * quickly.
+         */
+        class LoadListener {
+        public:
+            virtual ~LoadListener() {}
+            virtual void loadEvent(const LoadEvent &event) = 0;
+        };
+
+        /// Output formats of dumpTo().
+        enum DumpFormat {
+            /// The <modules> list that dumpTo() always wrote.
+            LIBMGR_DUMP_XML,
+            /// {"modules": [{"name", "src", "version", "revision"}, ...]}
+            LIBMGR_DUMP_JSON,
+            /// Length prefixed records, see DumpWriter.cpp for the layout.
+            LIBMGR_DUMP_BINARY,
+        };
+
+        /// What happens to a library once its last reference is released.
+        enum ReclaimMode {
+            /// It is destroyed right away, on the releasing thread.
+            LIBMGR_RECLAIM_IMMEDIATE,
+            /// It is queued until reclaimLibraries() is called.
+            LIBMGR_RECLAIM_DEFERRED,
+            /// It is queued and destroyed by a background thread.
+            LIBMGR_RECLAIM_BACKGROUND,
+        };
+
+        /**
+         * What visitLibraries() shows of a library. The views point into
+         * the manager and are only valid during LibVisitor::visit().
+         */
+        struct LibView {
+            LibId id;
+            std::string_view name;
+            std::string_view path;
+            int version;
+            std::string_view src;
+            std::string_view revision;
+            int references;
+        };
+
+        /**
+         * Receives the libraries in visitLibraries(). visit() is called
+         * with the library table locked and must not load, release or
+         * unload libraries.
+         */
+        class LibVisitor {
+        public:
+            virtual ~LibVisitor() {}
+            virtual void visit(const LibView &lib) = 0;
+        };
         
-        std::string errMessage[LIBMGR_NUM_ERRORS];
+        /// Same as errorStrings, kept for existing code.
+        static const std::string errMessage[LIBMGR_NUM_ERRORS];
+        static const char* getErrorString(ErrorNumber error)
+        { return (error >= 0 && error < LIBMGR_NUM_ERRORS ?
+                  errorStrings[error] : "unknown error"); }
         
         LibManager();
         ~LibManager();
+        LibManager(const LibManager &) = delete;
+        LibManager& operator=(const LibManager &) = delete;
         
-        ErrorNumber addLibrary(LibInterface *_lib, destroyLib *destroyFunc = NULL,const std::string &path = std::string());
+        ErrorNumber addLibrary(LibInterface *_lib, destroyLib *destroyFunc = NULL,const std::string &path = std::string(),
+                               LibId *id = NULL);
         ErrorNumber loadLibrary(const std::string &libPath,
-                                void *config = NULL);
+                                void *config = NULL, LibId *id = NULL,
+                                int flags = LIBMGR_LOAD_DEFAULTS);
         
+        LibId getLibraryId(const std::string &libName) const;
         LibInterface* acquireLibrary(const std::string &libName);
+        LibInterface* acquireLibrary(LibId id);
         template <typename T> T* acquireLibraryAs(const std::string &libName);
+        template <typename T> T* acquireLibraryAs(LibId id);
+        template <typename T> LibPtr<T> acquireLibraryPtr(const std::string &libName);
+        template <typename T> LibPtr<T> acquireLibraryPtr(LibId id);
+        template <typename T> std::vector<LibPtr<T> > findLibrariesImplementing();
         LibInterface* getLibrary(const std::string &libName)
         { return acquireLibrary(libName); }
         template <typename T> T* getLibraryAs(const std::string &libName)
         { return acquireLibraryAs<T>(libName); }
         
         ErrorNumber releaseLibrary(const std::string &libName);
+        ErrorNumber releaseLibrary(LibId id);
+        size_t acquireLibraries(const std::string *libNames, size_t count,
+                                LibInterface **libs, LibId *ids = NULL);
+        size_t acquireLibraries(const LibId *ids, size_t count,
+                                LibInterface **libs);
+        size_t releaseLibraries(const std::string *libNames, size_t count);
+        size_t releaseLibraries(const LibId *ids, size_t count);
+        void setReclaimMode(ReclaimMode mode);
+        ReclaimMode getReclaimMode() const
+        { return static_cast<ReclaimMode>(reclaimMode.load()); }
+        size_t reclaimLibraries();
         
         ErrorNumber unloadLibrary(const std::string &libPath);
+        ErrorNumber reloadLibrary(const std::string &libName, LibId *id = NULL);
+        ErrorNumber reloadLibraries(const std::vector<std::string> &libNames);
+        bool startWatching(unsigned int debounceMs = 500);
+        void stopWatching();
         void loadConfigFile(const std::string &config_file);
-        void getAllLibraries(std::list<LibInterface*> *libList);
+        std::future<ErrorNumber> loadLibraryAsync(const std::string &libPath,
+                                                  void *config = NULL,
+                                                  int flags = LIBMGR_LOAD_DEFAULTS);
+        std::future<void> loadConfigFileAsync(const std::string &config_file);
+        void setLogSink(LogSink *sink);
+        void setLogLevel(LogLevel level);
+        LogLevel getLogLevel() const;
+        static ErrorInfo getLastError();
+        static bool checkPlugin(const PluginDescriptor *plugin,
+                                std::string *error = NULL);
+        void addLoadListener(LoadListener *listener);
+        void removeLoadListener(LoadListener *listener);
+        void loadLibraries(const std::vector<std::string> &libPaths,
+                           const std::vector<int> *flags = NULL);
+        void getLoadOrder(const std::vector<std::string> &libPaths,
+                          std::vector<std::vector<std::string> > *levels);
+        void setDefaultLoadFlags(int flags)
+        { defaultLoadFlags = flags; }
+        int getDefaultLoadFlags() const
+        { return defaultLoadFlags; }
+        void setPrefetch(bool enabled)
+        { prefetch = enabled; }
+        bool getPrefetch() const
+        { return prefetch; }
+        void setNumLoadThreads(unsigned int numThreads);
+        unsigned int getNumLoadThreads() const
+        { return numLoadThreads; }
+        void setNumDestroyThreads(unsigned int numThreads);
+        unsigned int getNumDestroyThreads() const
+        { return numDestroyThreads; }
+        void clearPathCache();
+        bool readIndex(const std::string &filename);
+        bool writeIndex(const std::string &filename) const;
+        void clearIndex();
+        size_t probeLibraries(const std::vector<std::string> &libPaths,
+                              unsigned int numWorkers = 4,
+                              unsigned int timeoutMs = 10000,
+                              std::vector<std::string> *rejected = NULL);
+        bool publishRegistry(const std::string &name) const;
+        bool attachRegistry(const std::string &name);
+        static bool removeRegistry(const std::string &name);
+        /**
+         * Acquires the constructed libraries. Libraries registered with
+         * LIBMGR_LOAD_LAZY that were not acquired yet are skipped unless
+         * constructPending is true.
+         */
+        void getAllLibraries(std::list<LibInterface*> *libList,
+                             bool constructPending = false);
+        LibSnapshot snapshotLibraries();
         void getAllLibraryNames(std::list<std::string> *libNameList) const;
         LibInfo getLibraryInfo(const std::string &libName) const;
-        void dumpTo(const std::string &filename) const;
-        void clearLibraries(void);
+        void visitLibraries(LibVisitor *visitor) const;
+        bool visitLibrary(const std::string &libName, LibVisitor *visitor) const;
+        LibStats getLibraryStats(const std::string &libName) const;
+        void setRefTracking(bool enable, unsigned int backtraceEvery = 0);
+        bool getRefTracking() const;
+        static void setAcquireTag(const char *tag);
+        bool getLibraryTelemetry(const std::string &libName,
+                                 LibTelemetry *telemetry) const;
+        void setTracing(bool enable);
+        bool writeTrace(const std::string &filename) const;
+        void clearTrace();
+        bool dumpTo(const std::string &filename,
+                    DumpFormat format = LIBMGR_DUMP_XML) const;
+        bool dumpTo(FILE *file, DumpFormat format = LIBMGR_DUMP_XML) const;
+        bool dumpTo(int fd, DumpFormat format = LIBMGR_DUMP_XML) const;
+        bool dumpTo(std::string *buffer, DumpFormat format = LIBMGR_DUMP_XML) const;
+        void clearLibraries(ClearReport *report = NULL);
         
     private:
-        /// The container in which information on all managed libraries is stored.
-        std::map<std::string, libStruct> libMap;
+        /**
+         * The container in which information on all managed libraries is
+         * stored. A LibId indexes it directly; free slots have no
+         * libInterface and are listed in freeSlots. Slots never move, and
+         * all of them are freed at once when clearLibraries() leaves the
+         * table empty.
+         */
+        SlabPool<libStruct> libSlots;
+        std::vector<uint32_t> freeSlots;
+        /// Generation of newly created slots; LibIds from before the last
+        /// bulk free have a lower one.
+        uint32_t firstGeneration;
+        /// Maps each library name to its index in libSlots. The keys point
+        /// to the name stored in the slot.
+        std::unordered_map<std::string_view, uint32_t> libNames;
+        /// Slots of the libraries that want newLibLoaded() for every
+        /// library ...
+        std::vector<uint32_t> allSubscribers;
+        /// ... and for each library name the slots that subscribed to it.
+        std::unordered_map<std::string, std::vector<uint32_t> > libSubscribers;
+        /**
+         * Guards libSlots, freeSlots and libNames. Acquiring and releasing
+         * only take it shared; the use counts are atomic.
+         */
+        mutable std::shared_mutex tableMutex;
+        /**
+         * Serializes everything that adds or removes libraries. It is held
+         * while library code runs (create_c, newLibLoaded, destroy_c) and is
+         * recursive, so that this code can call back into the manager.
+         */
+        std::recursive_mutex loadMutex;
+        /**
+         * How many libStructs use each mapped library file. Every handle in
+         * here holds exactly one reference of the OS loader, which is
+         * dropped when the last libStruct is gone.
+         */
+        std::unordered_map<void*, int> handleRefs;
+        std::mutex handleMutex;
+        /// Number of threads used to map libraries in loadLibraries().
+        unsigned int numLoadThreads;
+        /// Number of threads destroyDetached() may use, see
+        /// setNumDestroyThreads().
+        unsigned int numDestroyThreads;
+        /// Runs the parallel passes of loadBatch() and destroyDetached(),
+        /// with as many threads as the larger of the two numbers.
+        ThreadPool *threadPool;
+        /// LoadFlags used when LIBMGR_LOAD_DEFAULTS is given.
+        int defaultLoadFlags;
+        /// Whether loadBatch() prefetches the library files, see
+        /// prefetchLibs().
+        bool prefetch;
+        /// Passes messages on to the LogSink.
+        Logger *logger;
+        /// Caches which file in the library search path a name resolves to.
+        PathResolver *pathResolver;
+        /// What is known about library files, optionally read from disk.
+        LibIndex *libIndex;
+        /// Receivers of LoadEvents, called with the mutex held.
+        std::vector<LoadListener*> loadListeners;
+        std::recursive_mutex listenerMutex;
+        /// Number of loads started with loadLibraryAsync() and
+        /// loadConfigFileAsync() that did not finish yet.
+        int asyncLoads;
+        std::mutex asyncMutex;
+        std::condition_variable asyncDone;
+        /// LibStats by library name, guarded by statsMutex.
+        std::unordered_map<std::string, LibStats> libStats;
+        mutable std::mutex statsMutex;
+        /// Timed load steps, if tracing is enabled.
+        LoadTrace *loadTrace;
+        /// Reloads changed library files if watching is enabled, else NULL.
+        /// Set and read with the load lock held.
+        LibWatcher *libWatcher;
+        /// A ReclaimMode.
+        std::atomic<int> reclaimMode;
+        /// Unused libraries waiting for destruction if reclaimMode is not
+        /// LIBMGR_RECLAIM_IMMEDIATE.
+        Reclaimer *reclaimer;
+        /// Outstanding references and contention histograms, see
+        /// setRefTracking().
+        RefTracker *refTracker;
+        /// Casts a library to one interface type, see castTo().
+        typedef void* CastFunc(LibInterface *lib);
+        /// The constructed libraries implementing one interface type.
+        struct Implementers {
+            Implementers(const std::type_index &t, CastFunc *c)
+                : type(t), cast(c) {}
+            std::type_index type;
+            CastFunc *cast;
+            std::vector<uint32_t> slots;
+        };
+        /**
+         * One entry for every type findLibrariesImplementing() was asked
+         * for. Together with libStruct::casts it is guarded by castMutex
+         * while the table lock is held shared; changes made with the table
+         * lock held exclusively need no castMutex.
+         */
+        std::vector<Implementers> implementers;
+        mutable std::shared_mutex castMutex;
+
+        void locateLib(const std::string &libPath, MappedLib *lib);
+        void mapLib(MappedLib *lib, bool withConfig, bool wantName);
+        bool canDefer(const MappedLib &lib) const;
+        ErrorNumber registerLazyLib(const MappedLib &lib, LibId *id);
+        bool instantiateLib(LibId id);
+        LibInterface* acquirePending(LibId id);
+        void recordLib(const MappedLib &lib, const LibInterface *interface);
+        static void cacheModuleInfo(const LibInterface *lib, libStruct *theLib);
+        void prepareSubscriptions(const LibInterface *lib, libStruct *theLib);
+        void notifySubscribers(uint32_t index, const std::string &name);
+        void loadBatch(std::vector<MappedLib> *batch);
+        void prefetchLibs(const std::vector<MappedLib> &libs);
+        void sortLibs(const std::vector<MappedLib> &libs,
+                      std::vector<std::vector<size_t> > *levels) const;
+        ErrorNumber constructLib(const MappedLib &lib, void *config,
+                                 LibId *id);
+        ErrorNumber loadMapped(MappedLib *lib, void *config, LibId *id,
+                               int flags, bool mapped);
+        libStruct* findLib(const std::string &libName, uint32_t *index = NULL);
+        const libStruct* findLib(const std::string &libName,
+                                 uint32_t *index = NULL) const;
+        libStruct* getLib(LibId id);
+        uint32_t claimSlot();
+        void freeLib(libStruct *theLib);
+        void destroyDetached(const std::vector<libStruct> &doomed,
+                             std::vector<std::string> *destroyed,
+                             std::vector<LibId> *cascaded = NULL);
+        void filesChanged(const std::vector<std::string> &filepaths);
+        void loadEvent(LoadEventType type, const MappedLib &lib,
+                       ErrorNumber error = LIBMGR_NO_ERROR);
+        void beginAsync();
+        void endAsync();
+        void closeHandle(void *handle);
+        void destroyInstance(const libStruct &theLib);
+        void recordLoadStats(const std::string &name, const MappedLib &lib,
+                             int64_t createTime);
+        void* refHandle(void *handle);
+        void unrefHandle(void *handle);
+        void addSubscriptions(uint32_t index);
+        void removeSubscriptions(uint32_t index);
+        ErrorNumber unloadLib(LibId id);
+        bool acquireRef(libStruct *theLib, int64_t lockWait = -1);
+        void trackRelease(libStruct *theLib, int references,
+                          int64_t lockWait = -1);
+        int64_t lockWaitStart() const;
+        bool dropRef(libStruct *theLib, LibId id, std::vector<LibId> *unused);
+        void reclaimUnused(const std::vector<LibId> &unused);
+        size_t sweepUnused(const std::vector<LibId> &unused,
+                           std::vector<std::string> *destroyed = NULL);
+        void fillLibInfo(const libStruct &theLib, LibInfo *info) const;
+        bool dumpModules(DumpWriter *writer) const;
+        void releaseSnapshot(const std::vector<LibSnapshot::Entry> &entries);
+        void* acquireCast(const std::string &libName,
+                          const std::type_index &type, CastFunc *cast);
+        void* acquireCast(LibId id, const std::type_index &type,
+                          CastFunc *cast);
+        void* finishCast(LibId id, bool pending, const std::type_index &type,
+                         CastFunc *cast);
+        void* lookupCast(libStruct *theLib, const std::type_index &type,
+                         CastFunc *cast);
+        void findImplementers(const std::type_index &type, CastFunc *cast,
+                              std::vector<LibId> *ids);
+        void indexInterfaces(uint32_t index);
+        void unindexInterfaces(uint32_t index);
+        template <typename T> static void* castTo(LibInterface *lib)
+        { return dynamic_cast<T*>(lib); }
+
+        friend class LibSnapshot;
         
     }; // class LibManager
+
+    /**
+     * Holds one reference to a library, acquired by
+     * LibManager::acquireLibraryPtr(), and releases it when destroyed.
+     *
+     * The pointer is cast to T once on acquisition and stored together with
+     * the LibId, so neither dereferencing nor releasing needs a lookup. A
+     * LibPtr can be moved but not copied; it may be moved to and released
+     * on any thread.
+     */
+    template <typename T>
+    class LibPtr {
+    public:
+        LibPtr() : manager(NULL), lib(NULL) {}
+
+        LibPtr(LibPtr &&other)
+        : manager(other.manager), libId(other.libId), lib(other.lib)
+        {
+            other.manager = NULL;
+            other.lib = NULL;
+            other.libId = LibId();
+        }
+
+        LibPtr& operator=(LibPtr &&other) {
+            if(this != &other) {
+                reset();
+                manager = other.manager;
+                libId = other.libId;
+                lib = other.lib;
+                other.manager = NULL;
+                other.lib = NULL;
+                other.libId = LibId();
+            }
+            return *this;
+        }
+
+        LibPtr(const LibPtr &) = delete;
+        LibPtr& operator=(const LibPtr &) = delete;
+
+        ~LibPtr()
+        { reset(); }
+
+        T* get() const
+        { return lib; }
+        T* operator->() const
+        { return lib; }
+        T& operator*() const
+        { return *lib; }
+        explicit operator bool() const
+        { return lib != NULL; }
+
+        /// The LibId of the held library; invalid if nothing is held.
+        LibId id() const
+        { return libId; }
+
+        /// Releases the reference early. The LibPtr is empty afterwards.
+        void reset() {
+            if(lib) {
+                manager->releaseLibrary(libId);
+                manager = NULL;
+                lib = NULL;
+                libId = LibId();
+            }
+        }
+
+    private:
+        friend class LibManager;
+
+        LibPtr(LibManager *theManager, LibId id, T *theLib)
+        : manager(theManager), libId(id), lib(theLib) {}
+
+        LibManager *manager;
+        LibId libId;
+        T *lib;
+    }; // class LibPtr
     
     // template implementations
+    /**
+     * Acquires the library and casts it to T. Returns NULL, without keeping
+     * a reference, if there is no such library or if it does not implement
+     * T. The result of the cast is cached per library and type, so only the
+     * first call for a type pays for the dynamic_cast.
+     */
     template <typename T>
     T* LibManager::acquireLibraryAs(const std::string &libName) {
-        T *lib = NULL;
-        LibInterface *libInterface = acquireLibrary(libName);
-        if(libInterface){
-            lib = dynamic_cast<T*>(libInterface);
-            if(!lib) {
-                releaseLibrary(libName);
+        return static_cast<T*>(acquireCast(libName, std::type_index(typeid(T)),
+                                           &castTo<T>));
+    }
+
+    template <typename T>
+    T* LibManager::acquireLibraryAs(LibId id) {
+        return static_cast<T*>(acquireCast(id, std::type_index(typeid(T)),
+                                           &castTo<T>));
+    }
+
+    /**
+     * Acquires the library and returns a LibPtr that releases it again when
+     * it goes out of scope. The LibPtr is empty if there is no such library
+     * or if it does not implement T.
+     */
+    template <typename T>
+    LibPtr<T> LibManager::acquireLibraryPtr(const std::string &libName) {
+        return acquireLibraryPtr<T>(getLibraryId(libName));
+    }
+
+    template <typename T>
+    LibPtr<T> LibManager::acquireLibraryPtr(LibId id) {
+        T *lib = acquireLibraryAs<T>(id);
+        if(!lib) {
+            return LibPtr<T>();
+        }
+        return LibPtr<T>(this, id, lib);
+    }
+
+    /**
+     * Acquires every constructed library that implements T. Libraries that
+     * are registered lazily and were not acquired yet are not constructed
+     * for this, and thus not returned.
+     *
+     * The first call for a type casts every library once; from then on the
+     * manager keeps the list up to date as libraries come and go, so later
+     * calls do not cast at all.
+     */
+    template <typename T>
+    std::vector<LibPtr<T> > LibManager::findLibrariesImplementing() {
+        std::vector<LibId> ids;
+        findImplementers(std::type_index(typeid(T)), &castTo<T>, &ids);
+        std::vector<LibPtr<T> > libs;
+        libs.reserve(ids.size());
+        for(size_t i = 0; i < ids.size(); ++i) {
+            LibPtr<T> lib = acquireLibraryPtr<T>(ids[i]);
+            if(lib) {
+                libs.push_back(std::move(lib));
             }
         }
-        return lib;
+        return libs;
     }
     
 } // namespace lib_manager
@@ -0,0 +1,432 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file LibWatcher.cpp
+ * \brief "LibWatcher" reports modified library files.
+ *
+ */
+
+#include "LibWatcher.h"
+#include "Logger.h"
+
+#include <cerrno>
+
+#if defined(__linux__)
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#endif
+
+namespace lib_manager {
+
+using namespace std;
+
+/**
+ * Splits a file path into its directory and file name.
+ */
+static void splitPath(const string &filepath, string *dir, string *name)
+{
+#ifdef WIN32
+    size_t pos = filepath.find_last_of("/\\");
+#else
+    size_t pos = filepath.rfind('/');
+#endif
+    if(pos == string::npos) {
+        *dir = ".";
+        *name = filepath;
+    } else {
+        *dir = pos == 0 ? filepath.substr(0, 1) : filepath.substr(0, pos);
+        *name = filepath.substr(pos + 1);
+    }
+}
+
+/**
+ * Records a change of the file name in dir, if it is watched, and restarts
+ * the debounce time. Must be called with the mutex held.
+ */
+void LibWatcher::fileChanged(const Dir &dir, const string &name)
+{
+    map<string, string>::const_iterator it = dir.files.find(name);
+    if(it == dir.files.end()) {
+        return;
+    }
+    changed.insert(it->second);
+    deadline = chrono::steady_clock::now() + chrono::milliseconds(debounceMs);
+}
+
+/**
+ * Returns the milliseconds until the collected changes are due, or -1 if
+ * there are none. Must be called with the mutex held.
+ */
+int LibWatcher::timeout()
+{
+    if(changed.empty()) {
+        return -1;
+    }
+    chrono::steady_clock::duration left;
+    left = deadline - chrono::steady_clock::now();
+    long long ms = chrono::duration_cast<chrono::milliseconds>(left).count();
+    return ms < 0 ? 0 : (int)ms + 1;
+}
+
+/**
+ * Hands the collected changes to the callback once they are due.
+ */
+void LibWatcher::flush()
+{
+    vector<string> files;
+    {
+        lock_guard<mutex> lock(watchMutex);
+        if(changed.empty() || chrono::steady_clock::now() < deadline) {
+            return;
+        }
+        files.assign(changed.begin(), changed.end());
+        changed.clear();
+    }
+    callback(files);
+}
+
+#if defined(__linux__)
+
+LibWatcher::LibWatcher(Logger *logger, unsigned int debounceMs,
+                       const Callback &callback)
+    : logger(logger), debounceMs(debounceMs), callback(callback), inotifyFd(-1)
+{
+    stopPipe[0] = stopPipe[1] = -1;
+}
+
+LibWatcher::~LibWatcher() {
+    stop();
+}
+
+bool LibWatcher::start()
+{
+    lock_guard<mutex> lock(watchMutex);
+    if(thread.joinable()) {
+        return true;
+    }
+    inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if(inotifyFd < 0) {
+        return false;
+    }
+    if(pipe(stopPipe) != 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+        return false;
+    }
+    thread = std::thread(&LibWatcher::run, this);
+    return true;
+}
+
+void LibWatcher::stop()
+{
+    {
+        lock_guard<mutex> lock(watchMutex);
+        if(!thread.joinable()) {
+            return;
+        }
+        char c = 0;
+        if(write(stopPipe[1], &c, 1) != 1) {
+            LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_ERROR,
+                       "LibManager: cannot stop the library watcher.");
+        }
+    }
+    thread.join();
+    lock_guard<mutex> lock(watchMutex);
+    close(inotifyFd);
+    close(stopPipe[0]);
+    close(stopPipe[1]);
+    inotifyFd = stopPipe[0] = stopPipe[1] = -1;
+    dirs.clear();
+    changed.clear();
+}
+
+bool LibWatcher::watch(const string &filepath)
+{
+    string dirPath, name;
+    splitPath(filepath, &dirPath, &name);
+    lock_guard<mutex> lock(watchMutex);
+    if(inotifyFd < 0) {
+        return false;
+    }
+    // watch the directory, files are usually replaced by a new one
+    int wd = inotify_add_watch(inotifyFd, dirPath.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO);
+    if(wd < 0) {
+        LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_WARNING,
+                   "LibManager: cannot watch \"%s\".", dirPath.c_str());
+        return false;
+    }
+    Dir &dir = dirs[wd];
+    dir.path = dirPath;
+    dir.files[name] = filepath;
+    return true;
+}
+
+void LibWatcher::run()
+{
+    struct pollfd fds[2];
+    fds[0].fd = inotifyFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stopPipe[0];
+    fds[1].events = POLLIN;
+    // aligned as required for struct inotify_event
+    alignas(struct inotify_event) char buffer[4096];
+
+    while(true) {
+        int wait;
+        {
+            lock_guard<mutex> lock(watchMutex);
+            wait = timeout();
+        }
+        int result = poll(fds, 2, wait);
+        if(result < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_ERROR,
+                       "LibManager: library watcher failed.");
+            return;
+        }
+        if(fds[1].revents) {
+            return;
+        }
+        if(fds[0].revents & POLLIN) {
+            ssize_t len;
+            while((len = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+                lock_guard<mutex> lock(watchMutex);
+                for(char *p = buffer; p < buffer + len; ) {
+                    struct inotify_event *event = (struct inotify_event*)p;
+                    map<int, Dir>::const_iterator it = dirs.find(event->wd);
+                    if(event->len && it != dirs.end()) {
+                        fileChanged(it->second, event->name);
+                    }
+                    p += sizeof(struct inotify_event) + event->len;
+                }
+            }
+        }
+        flush();
+    }
+}
+
+#elif defined(WIN32)
+
+LibWatcher::LibWatcher(Logger *logger, unsigned int debounceMs,
+                       const Callback &callback)
+    : logger(logger), debounceMs(debounceMs), callback(callback), wakeEvent(NULL),
+      stopping(false)
+{
+}
+
+LibWatcher::~LibWatcher() {
+    stop();
+}
+
+bool LibWatcher::start()
+{
+    lock_guard<mutex> lock(watchMutex);
+    if(thread.joinable()) {
+        return true;
+    }
+    wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if(!wakeEvent) {
+        return false;
+    }
+    stopping = false;
+    thread = std::thread(&LibWatcher::run, this);
+    return true;
+}
+
+void LibWatcher::stop()
+{
+    {
+        lock_guard<mutex> lock(watchMutex);
+        if(!thread.joinable()) {
+            return;
+        }
+        stopping = true;
+        SetEvent(wakeEvent);
+    }
+    thread.join();
+    lock_guard<mutex> lock(watchMutex);
+    for(map<string, Dir*>::iterator it = dirs.begin(); it != dirs.end(); ++it) {
+        Dir *dir = it->second;
+        if(dir->armed) {
+            CancelIoEx(dir->handle, &dir->overlapped);
+            DWORD bytes;
+            GetOverlappedResult(dir->handle, &dir->overlapped, &bytes, TRUE);
+        }
+        CloseHandle(dir->overlapped.hEvent);
+        CloseHandle(dir->handle);
+        delete dir;
+    }
+    dirs.clear();
+    changed.clear();
+    CloseHandle(wakeEvent);
+    wakeEvent = NULL;
+}
+
+bool LibWatcher::watch(const string &filepath)
+{
+    string dirPath, name;
+    splitPath(filepath, &dirPath, &name);
+    lock_guard<mutex> lock(watchMutex);
+    if(!wakeEvent) {
+        return false;
+    }
+    map<string, Dir*>::iterator it = dirs.find(dirPath);
+    if(it == dirs.end()) {
+        // WaitForMultipleObjects() also has to wait for wakeEvent
+        if(dirs.size() + 1 >= MAXIMUM_WAIT_OBJECTS) {
+            LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_WARNING,
+                       "LibManager: cannot watch \"%s\", too many "
+                       "directories.", dirPath.c_str());
+            return false;
+        }
+        HANDLE handle = CreateFile(dirPath.c_str(), FILE_LIST_DIRECTORY,
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                   FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                                   FILE_FLAG_BACKUP_SEMANTICS |
+                                   FILE_FLAG_OVERLAPPED, NULL);
+        if(handle == INVALID_HANDLE_VALUE) {
+            LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_WARNING,
+                       "LibManager: cannot watch \"%s\".", dirPath.c_str());
+            return false;
+        }
+        Dir *dir = new Dir();
+        dir->path = dirPath;
+        dir->handle = handle;
+        ZeroMemory(&dir->overlapped, sizeof(dir->overlapped));
+        dir->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        dir->armed = false;
+        it = dirs.insert(make_pair(dirPath, dir)).first;
+        SetEvent(wakeEvent);
+    }
+    // file names are compared case insensitive by the file system, but the
+    // loader gets them in the same spelling every time
+    it->second->files[name] = filepath;
+    return true;
+}
+
+void LibWatcher::run()
+{
+    while(true) {
+        vector<HANDLE> handles;
+        vector<Dir*> watched;
+        int wait;
+        {
+            lock_guard<mutex> lock(watchMutex);
+            if(stopping) {
+                return;
+            }
+            for(map<string, Dir*>::iterator it = dirs.begin();
+                it != dirs.end(); ++it) {
+                Dir *dir = it->second;
+                if(!dir->armed) {
+                    ResetEvent(dir->overlapped.hEvent);
+                    dir->armed = ReadDirectoryChangesW(dir->handle, dir->buffer,
+                                                       sizeof(dir->buffer), FALSE,
+                                                       FILE_NOTIFY_CHANGE_LAST_WRITE |
+                                                       FILE_NOTIFY_CHANGE_FILE_NAME,
+                                                       NULL, &dir->overlapped,
+                                                       NULL) != 0;
+                }
+                if(dir->armed) {
+                    handles.push_back(dir->overlapped.hEvent);
+                    watched.push_back(dir);
+                }
+            }
+            handles.push_back(wakeEvent);
+            wait = timeout();
+        }
+
+        DWORD result = WaitForMultipleObjects(handles.size(), &handles[0],
+                                              FALSE, wait < 0 ? INFINITE : wait);
+        if(result >= WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + watched.size()) {
+            lock_guard<mutex> lock(watchMutex);
+            Dir *dir = watched[result - WAIT_OBJECT_0];
+            DWORD bytes = 0;
+            dir->armed = false;
+            if(GetOverlappedResult(dir->handle, &dir->overlapped, &bytes,
+                                   FALSE) && bytes) {
+                const char *p = reinterpret_cast<const char*>(dir->buffer);
+                while(true) {
+                    const FILE_NOTIFY_INFORMATION *info =
+                        reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(p);
+                    if(info->Action == FILE_ACTION_ADDED ||
+                       info->Action == FILE_ACTION_MODIFIED ||
+                       info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+                        int wlen = info->FileNameLength / sizeof(WCHAR);
+                        int len = WideCharToMultiByte(CP_ACP, 0, info->FileName,
+                                                      wlen, NULL, 0, NULL, NULL);
+                        string name(len, '\0');
+                        WideCharToMultiByte(CP_ACP, 0, info->FileName, wlen,
+                                            &name[0], len, NULL, NULL);
+                        fileChanged(*dir, name);
+                    }
+                    if(!info->NextEntryOffset) {
+                        break;
+                    }
+                    p += info->NextEntryOffset;
+                }
+            }
+        } else if(result == WAIT_FAILED) {
+            LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_ERROR,
+                       "LibManager: library watcher failed.");
+            return;
+        }
+        flush();
+    }
+}
+
+#else
+
+LibWatcher::LibWatcher(Logger *logger, unsigned int debounceMs,
+                       const Callback &callback)
+    : logger(logger), debounceMs(debounceMs), callback(callback)
+{
+}
+
+LibWatcher::~LibWatcher() {
+}
+
+bool LibWatcher::start()
+{
+    return false;
+}
+
+void LibWatcher::stop()
+{
+}
+
+bool LibWatcher::watch(const string &filepath)
+{
+    return false;
+}
+
+void LibWatcher::run()
+{
+}
+
+#endif
+
+} // end of namespace lib_manager
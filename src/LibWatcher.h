@@ -0,0 +1,121 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file LibWatcher.h
+ * \brief "LibWatcher" reports modified library files.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_LIB_WATCHER_H
+#define LIB_MANAGER_LIB_WATCHER_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef WIN32
+#  include <windows.h>
+#endif
+
+namespace lib_manager {
+
+    class Logger;
+
+    /**
+     * Watches the directories of library files on a background thread
+     * (inotify on Linux, ReadDirectoryChangesW on Windows; not available
+     * elsewhere) and reports files that were written or moved into place.
+     *
+     * Changes are collected until no further change happened for the
+     * debounce time. The callback is then called once with all changed
+     * files, on the watcher thread. It must not call stop().
+     *
+     * All methods are thread safe.
+     */
+    class LibWatcher {
+    public:
+        typedef std::function<void(const std::vector<std::string>&)> Callback;
+
+        LibWatcher(Logger *logger, unsigned int debounceMs,
+                   const Callback &callback);
+        ~LibWatcher();
+        LibWatcher(const LibWatcher &) = delete;
+        LibWatcher& operator=(const LibWatcher &) = delete;
+
+        /// Starts the watcher thread. Returns false if watching is not
+        /// supported or the thread could not be set up.
+        bool start();
+
+        /// Stops and joins the watcher thread. Pending changes are dropped.
+        void stop();
+
+        /**
+         * Adds a library file. Its path is reported exactly as given here.
+         * Returns false if its directory cannot be watched.
+         */
+        bool watch(const std::string &filepath);
+
+    private:
+        struct Dir {
+            std::string path;
+            /// File name in the directory -> path passed to watch()
+            std::map<std::string, std::string> files;
+#ifdef WIN32
+            HANDLE handle;
+            OVERLAPPED overlapped;
+            bool armed;
+            DWORD buffer[4096];
+#endif
+        };
+
+        Logger *logger;
+        std::mutex watchMutex;
+        std::thread thread;
+        unsigned int debounceMs;
+        Callback callback;
+        std::set<std::string> changed;
+        std::chrono::steady_clock::time_point deadline;
+#ifdef WIN32
+        std::map<std::string, Dir*> dirs;
+        HANDLE wakeEvent;
+        bool stopping;
+#else
+        std::map<int, Dir> dirs;
+        int inotifyFd;
+        int stopPipe[2];
+#endif
+
+        void run();
+        void fileChanged(const Dir &dir, const std::string &name);
+        int timeout();
+        void flush();
+    }; // class LibWatcher
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_LIB_WATCHER_H */
@@ -0,0 +1,118 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file LoadTrace.cpp
+ * \brief "LoadTrace" records the load steps of libraries for a trace viewer.
+ *
+ */
+
+#include "LoadTrace.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace lib_manager {
+
+using namespace std;
+
+int64_t traceClock()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Returns a small number for the calling thread, used as trace thread id.
+ */
+static unsigned int traceThread()
+{
+    static atomic<unsigned int> nextThread(1);
+    static thread_local unsigned int thread = nextThread.fetch_add(1);
+    return thread;
+}
+
+/**
+ * Writes str as JSON string contents.
+ */
+static void writeJsonString(FILE *file, const string &str)
+{
+    for(size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = str[i];
+        if(c == '"' || c == '\\') {
+            fprintf(file, "\\%c", c);
+        } else if(c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+}
+
+LoadTrace::LoadTrace() : enabled(false), origin(traceClock()) {
+}
+
+void LoadTrace::record(const char *step, const string &libName,
+                       int64_t start, int64_t duration)
+{
+    if(!isEnabled()) {
+        return;
+    }
+    Span span;
+    span.step = step;
+    span.libName = libName;
+    span.start = start;
+    span.duration = duration;
+    span.thread = traceThread();
+    lock_guard<mutex> lock(traceMutex);
+    spans.push_back(span);
+}
+
+bool LoadTrace::write(const string &filename) const
+{
+    FILE *file = fopen(filename.c_str(), "w");
+    if(!file) {
+        return false;
+    }
+    lock_guard<mutex> lock(traceMutex);
+    fprintf(file, "{\"traceEvents\":[\n");
+    for(size_t i = 0; i < spans.size(); ++i) {
+        const Span &span = spans[i];
+        // the format wants microseconds
+        fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"lib_manager\",\"ph\":\"X\","
+                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"lib\":\"", i ? ",\n" : "", span.step,
+                (span.start - origin) / 1000.0, span.duration / 1000.0,
+                span.thread);
+        writeJsonString(file, span.libName);
+        fprintf(file, "\"}}");
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(file) == 0;
+}
+
+void LoadTrace::clear()
+{
+    lock_guard<mutex> lock(traceMutex);
+    spans.clear();
+    origin = traceClock();
+}
+
+} // end of namespace lib_manager
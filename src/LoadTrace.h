@@ -0,0 +1,87 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file LoadTrace.h
+ * \brief "LoadTrace" records the load steps of libraries for a trace viewer.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_LOAD_TRACE_H
+#define LIB_MANAGER_LOAD_TRACE_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace lib_manager {
+
+    /// Returns a monotonic time stamp in nanoseconds.
+    int64_t traceClock();
+
+    /**
+     * Collects timed spans (e.g. "dlopen" of one library) while enabled and
+     * writes them in the Chrome trace event format, which chrome://tracing
+     * and Perfetto can display.
+     *
+     * All methods are thread safe. Recording costs one atomic load while
+     * disabled.
+     */
+    class LoadTrace {
+    public:
+        LoadTrace();
+
+        void setEnabled(bool enable)
+        { enabled.store(enable, std::memory_order_relaxed); }
+        bool isEnabled() const
+        { return enabled.load(std::memory_order_relaxed); }
+
+        /**
+         * Records a span that started at start (see traceClock()) and took
+         * duration nanoseconds. step must be a string literal.
+         */
+        void record(const char *step, const std::string &libName,
+                    int64_t start, int64_t duration);
+
+        bool write(const std::string &filename) const;
+        void clear();
+
+    private:
+        struct Span {
+            const char *step;
+            std::string libName;
+            int64_t start;
+            int64_t duration;
+            unsigned int thread;
+        };
+
+        std::atomic<bool> enabled;
+        mutable std::mutex traceMutex;
+        std::vector<Span> spans;
+        int64_t origin;
+    }; // class LoadTrace
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_LOAD_TRACE_H */
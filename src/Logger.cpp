@@ -0,0 +1,75 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file Logger.cpp
+ * \brief "Logger" hands the messages of the LibManager to its LogSink.
+ *
+ */
+
+#include "Logger.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+
+namespace lib_manager {
+
+using namespace std;
+
+Logger::Logger() : threshold(LibManager::LIBMGR_LOG_INFO), sink(NULL) {
+}
+
+void Logger::setSink(LibManager::LogSink *sink)
+{
+    lock_guard<mutex> lock(sinkMutex);
+    this->sink = sink;
+}
+
+void Logger::log(LibManager::LogLevel level, const char *format, ...)
+{
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if(len < 0) {
+        return;
+    }
+    string message;
+    const char *text = buffer;
+    if((size_t)len >= sizeof(buffer)) {
+        message.resize(len + 1);
+        va_start(args, format);
+        vsnprintf(&message[0], message.size(), format, args);
+        va_end(args);
+        message.resize(len);
+        text = message.c_str();
+    }
+
+    lock_guard<mutex> lock(sinkMutex);
+    if(sink) {
+        sink->log(level, text);
+    } else {
+        fprintf(stderr, "%s\n", text);
+    }
+}
+
+} // end of namespace lib_manager
@@ -0,0 +1,96 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file Logger.h
+ * \brief "Logger" hands the messages of the LibManager to its LogSink.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_LOGGER_H
+#define LIB_MANAGER_LOGGER_H
+
+#include "LibManager.h"
+
+#include <atomic>
+#include <mutex>
+
+/**
+ * Messages above this level are not even compiled in. Set it with the
+ * LIB_MANAGER_MAX_LOG_LEVEL CMake option.
+ */
+#ifndef LIB_MANAGER_MAX_LOG_LEVEL
+#  define LIB_MANAGER_MAX_LOG_LEVEL 3
+#endif
+
+#if defined(__GNUC__)
+#  define LIBMGR_PRINTF_FORMAT(fmt, args) __attribute__((format(printf, fmt, args)))
+#else
+#  define LIBMGR_PRINTF_FORMAT(fmt, args)
+#endif
+
+/**
+ * Logs a printf style message. The arguments are only evaluated if the
+ * level is enabled.
+ */
+#define LIBMGR_LOG(logger, level, ...)                                  \
+    do {                                                                \
+        if((level) <= LIB_MANAGER_MAX_LOG_LEVEL &&                      \
+           (logger)->enabled(level)) {                                  \
+            (logger)->log(level, __VA_ARGS__);                          \
+        }                                                               \
+    } while(0)
+
+namespace lib_manager {
+
+    /**
+     * Filters messages by level and passes them on to a LogSink, or to
+     * stderr if none is set.
+     *
+     * All methods are thread safe. The sink is called with a mutex held, so
+     * messages of several threads never interleave.
+     */
+    class Logger {
+    public:
+        Logger();
+
+        void setSink(LibManager::LogSink *sink);
+        void setLevel(LibManager::LogLevel level)
+        { threshold.store(level, std::memory_order_relaxed); }
+        LibManager::LogLevel getLevel() const
+        { return (LibManager::LogLevel)threshold.load(std::memory_order_relaxed); }
+
+        bool enabled(LibManager::LogLevel level) const
+        { return level <= threshold.load(std::memory_order_relaxed); }
+
+        void log(LibManager::LogLevel level, const char *format, ...)
+            LIBMGR_PRINTF_FORMAT(3, 4);
+
+    private:
+        std::atomic<int> threshold;
+        std::mutex sinkMutex;
+        LibManager::LogSink *sink;
+    }; // class Logger
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_LOGGER_H */
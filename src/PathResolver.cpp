@@ -0,0 +1,230 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file PathResolver.cpp
+ * \brief "PathResolver" maps library names to files in the library search
+ *        path and caches the result.
+ *
+ */
+
+#include "PathResolver.h"
+#include "Logger.h"
+
+#include <stdlib.h>
+
+namespace lib_manager {
+
+using namespace std;
+
+static const char *prefix = "lib";
+#ifdef WIN32
+static const char *suffix = ".dll";
+static const char sep = ';';
+static const char *env = "PATH";
+#elif __APPLE__
+static const char *suffix = ".dylib";
+static const char sep = ':';
+static const char *env = "DYLD_LIBRARY_PATH";
+#else
+static const char *suffix = ".so";
+static const char sep = ':';
+static const char *env = "LD_LIBRARY_PATH";
+#endif
+
+/**
+ * Returns true if path names an existing file that is not a directory.
+ */
+static bool isFile(const string &path)
+{
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    return !S_ISDIR(st.st_mode);
+}
+
+PathResolver::PathResolver(Logger *logger) : logger(logger), envSet(false),
+                                             generation(1) {
+}
+
+string PathResolver::resolve(const string &libPath)
+{
+    // as given, e.g. relative to the working directory, always comes first
+    // and is never cached, since the working directory can change
+    if(isFile(libPath)) {
+        return libPath;
+    }
+
+    unique_lock<mutex> lock(cacheMutex);
+    refreshSearchPath();
+
+    map<string, Entry>::iterator it = cache.find(libPath);
+    if(it != cache.end() && dirsUnchanged(it->second.lastDir)) {
+        return it->second.filepath;
+    }
+
+    // probe without holding the lock, so that several load threads can
+    // resolve their libraries at the same time
+    const string searchPath = envValue;
+    vector<string> dirPaths;
+    dirPaths.reserve(dirs.size());
+    for(size_t i = 0; i < dirs.size(); ++i) {
+        dirPaths.push_back(dirs[i].path);
+    }
+    lock.unlock();
+
+    Entry entry;
+    entry.filepath = prefix;
+    entry.filepath.append(libPath);
+    entry.filepath.append(suffix);
+    entry.lastDir = dirPaths.empty() ? 0 : dirPaths.size() - 1;
+    for(size_t i = 0; i < dirPaths.size(); ++i) {
+        string actual_lib_path = dirPaths[i];
+        actual_lib_path.append("/");
+        actual_lib_path.append(entry.filepath);
+        if(isFile(actual_lib_path)) {
+            entry.filepath = actual_lib_path;
+            entry.lastDir = i;
+            LIBMGR_LOG(logger, LibManager::LIBMGR_LOG_INFO,
+                       "lib_manager: found plugin at: %s",
+                       entry.filepath.c_str());
+            break;
+        }
+    }
+
+    lock.lock();
+    if(envValue == searchPath) {
+        cache[libPath] = entry;
+    }
+    return entry.filepath;
+}
+
+void PathResolver::nextGeneration()
+{
+    lock_guard<mutex> lock(cacheMutex);
+    ++generation;
+}
+
+void PathResolver::clear()
+{
+    lock_guard<mutex> lock(cacheMutex);
+    cache.clear();
+    envSet = false;
+    envValue.clear();
+    dirs.clear();
+}
+
+string PathResolver::searchPath()
+{
+    const char *lib_path = getenv(env);
+    return lib_path ? lib_path : "";
+}
+
+void PathResolver::splitSearchPath(const string &value,
+                                   vector<string> *dirPaths)
+{
+    size_t next_path_pos = 0;
+    size_t actual_path_pos = 0;
+    while(next_path_pos != string::npos) {
+        next_path_pos = value.find(sep, actual_path_pos);
+        dirPaths->push_back(value.substr(actual_path_pos, (next_path_pos != string::npos) ? next_path_pos - actual_path_pos : value.size() - actual_path_pos));
+        actual_path_pos = next_path_pos + 1;
+    }
+}
+
+int64_t PathResolver::modificationTime(const struct stat &st)
+{
+#if defined(__APPLE__)
+    return (int64_t)st.st_mtimespec.tv_sec * 1000000000 +
+        st.st_mtimespec.tv_nsec;
+#elif defined(WIN32)
+    return (int64_t)st.st_mtime * 1000000000;
+#else
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+int64_t PathResolver::dirTime(const string &path)
+{
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) {
+        return 0;
+    }
+    return modificationTime(st);
+}
+
+/**
+ * Splits the search path environment variable again if its value changed
+ * since the last call. Must be called with the mutex held.
+ */
+void PathResolver::refreshSearchPath()
+{
+    const char *lib_path = getenv(env);
+    if(envSet == (lib_path != NULL) && (!lib_path || envValue == lib_path)) {
+        return;
+    }
+
+    envSet = (lib_path != NULL);
+    envValue = lib_path ? lib_path : "";
+    cache.clear();
+    dirs.clear();
+    if(!lib_path) {
+        return;
+    }
+
+    vector<string> dirPaths;
+    splitSearchPath(envValue, &dirPaths);
+    for(size_t i = 0; i < dirPaths.size(); ++i) {
+        SearchDir dir;
+        dir.path = dirPaths[i];
+        dir.mtime = dirTime(dir.path);
+        dir.checkedGeneration = generation;
+        dirs.push_back(dir);
+    }
+}
+
+/**
+ * Checks that the search directories up to lastDir were not modified. Every
+ * directory is looked at at most once per generation. If one did change, the
+ * whole cache is dropped. Must be called with the mutex held.
+ */
+bool PathResolver::dirsUnchanged(size_t lastDir)
+{
+    bool unchanged = true;
+    for(size_t i = 0; i <= lastDir && i < dirs.size(); ++i) {
+        SearchDir &dir = dirs[i];
+        if(dir.checkedGeneration == generation) {
+            continue;
+        }
+        dir.checkedGeneration = generation;
+        int64_t mtime = dirTime(dir.path);
+        if(mtime != dir.mtime) {
+            dir.mtime = mtime;
+            unchanged = false;
+        }
+    }
+    if(!unchanged) {
+        cache.clear();
+    }
+    return unchanged;
+}
+
+} // end of namespace lib_manager
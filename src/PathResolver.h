@@ -0,0 +1,122 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file PathResolver.h
+ * \brief "PathResolver" maps library names to files in the library search
+ *        path and caches the result.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_PATH_RESOLVER_H
+#define LIB_MANAGER_PATH_RESOLVER_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace lib_manager {
+
+    class Logger;
+
+    /**
+     * Resolves the library paths given to LibManager::loadLibrary().
+     *
+     * The library search path environment variable is only split again when
+     * its value changes. Every resolved name is cached together with the
+     * index of the search directory it was found in. A cached entry stays
+     * valid as long as none of the directories up to and including that one
+     * changed its modification time. The directory times are checked at most
+     * once per generation (see nextGeneration()). Files are probed with
+     * access()/stat() and never opened.
+     *
+     * All methods are thread safe.
+     */
+    class PathResolver {
+    public:
+        explicit PathResolver(Logger *logger);
+
+        /**
+         * Returns the file that should be handed to dlopen for libPath:
+         * libPath itself if it names a file, else the file found in the
+         * search path. If neither exists, the platform specific file name
+         * (e.g. "lib<name>.so") is returned so that the dynamic linker can
+         * still try its default locations.
+         */
+        std::string resolve(const std::string &libPath);
+
+        /**
+         * Starts a new generation: the search directories are checked for
+         * modifications again on the next lookup that needs them.
+         */
+        void nextGeneration();
+
+        /// Drops all cached entries.
+        void clear();
+
+        /// The current value of the library search path variable, e.g.
+        /// LD_LIBRARY_PATH, or "" if it is not set.
+        static std::string searchPath();
+
+        /// Splits a value of the search path variable into directories.
+        static void splitSearchPath(const std::string &value,
+                                    std::vector<std::string> *dirPaths);
+
+        /// The modification time in st in nanoseconds, so that changes
+        /// within the same second are seen too.
+        static int64_t modificationTime(const struct stat &st);
+
+        /// The modification time of a directory, or 0 if it does not exist.
+        static int64_t dirTime(const std::string &path);
+
+    private:
+        struct SearchDir {
+            std::string path;
+            int64_t mtime;
+            unsigned long checkedGeneration;
+        };
+
+        struct Entry {
+            std::string filepath;
+            /// All directories up to this index must be unmodified.
+            size_t lastDir;
+        };
+
+        Logger *logger;
+        std::mutex cacheMutex;
+        bool envSet;
+        std::string envValue;
+        std::vector<SearchDir> dirs;
+        std::map<std::string, Entry> cache;
+        unsigned long generation;
+
+        void refreshSearchPath();
+        bool dirsUnchanged(size_t lastDir);
+    }; // class PathResolver
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_PATH_RESOLVER_H */
@@ -0,0 +1,370 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file Prober.cpp
+ * \brief Tries out library files in child processes.
+ *
+ * A child reports back through a pipe with one message, written once the
+ * probe is done:
+ *   uint32 loaded, probed, found; int32 version;
+ *   string libName, detail; uint32 numDependencies; string dependencies[]
+ * where every string is a uint32 length followed by the bytes. A child that
+ * dies before it wrote the whole message has crashed.
+ */
+
+#include "Prober.h"
+#include "LibIndex.h"
+#include "LibManager.h"
+
+#ifndef WIN32
+#  include <chrono>
+#  include <cerrno>
+#  include <cstring>
+#  include <dlfcn.h>
+#  include <poll.h>
+#  include <signal.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+namespace lib_manager {
+
+using namespace std;
+
+#ifdef WIN32
+
+void probeFiles(LibManager *, vector<ProbeResult> *, unsigned int,
+                unsigned int)
+{
+}
+
+#else // WIN32
+
+static void putU32(string *out, uint32_t value)
+{
+    out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void putString(string *out, const string &value)
+{
+    putU32(out, value.size());
+    out->append(value);
+}
+
+static bool getU32(const string &in, size_t *pos, uint32_t *value)
+{
+    if(in.size() - *pos < sizeof(*value)) {
+        return false;
+    }
+    memcpy(value, in.data() + *pos, sizeof(*value));
+    *pos += sizeof(*value);
+    return true;
+}
+
+static bool getString(const string &in, size_t *pos, string *value)
+{
+    uint32_t size;
+    if(!getU32(in, pos, &size) || in.size() - *pos < size) {
+        return false;
+    }
+    value->assign(in, *pos, size);
+    *pos += size;
+    return true;
+}
+
+/**
+ * Looks up one factory symbol in the child and notes it in the bits.
+ */
+template <typename T>
+static T probeSymbol(void *handle, const char *name, uint32_t symbol,
+                     uint32_t *probed, uint32_t *found)
+{
+    T func = reinterpret_cast<T>(dlsym(handle, name));
+    *probed |= symbol;
+    if(func) {
+        *found |= symbol;
+    }
+    return func;
+}
+
+/**
+ * Runs in the child: probes filepath and writes the message to fd.
+ */
+static void runProbe(LibManager *manager, const string &filepath, int fd)
+{
+    uint32_t loaded = 0, probed = 0, found = 0;
+    int32_t version = 0;
+    string libName, detail;
+    vector<string> dependencies;
+
+    void *handle = dlopen(filepath.c_str(), RTLD_LAZY | RTLD_LOCAL);
+    if(!handle) {
+        const char *error = dlerror();
+        detail = error ? error : "dlopen failed";
+    } else {
+        loaded = 1;
+        createLib *create = NULL;
+        destroyLib *destroy = NULL;
+        const PluginDescriptor *plugin =
+            probeSymbol<const PluginDescriptor*>(handle,
+                                                 "lib_manager_plugin_v2",
+                                                 INDEX_SYM_DESCRIPTOR,
+                                                 &probed, &found);
+        if(plugin) {
+            if(LibManager::checkPlugin(plugin, &detail)) {
+                create = plugin->create;
+                destroy = plugin->destroy;
+                // recorded like in LibManager::mapLib()
+                probed |= (INDEX_SYM_CREATE | INDEX_SYM_CONFIG_CREATE |
+                           INDEX_SYM_DESTROY);
+                found |= ((create ? INDEX_SYM_CREATE : 0) |
+                          (plugin->configCreate ? INDEX_SYM_CONFIG_CREATE : 0) |
+                          INDEX_SYM_DESTROY);
+            }
+        } else {
+            create = probeSymbol<createLib*>(handle, "create_c",
+                                             INDEX_SYM_CREATE,
+                                             &probed, &found);
+            probeSymbol<createLib2*>(handle, "config_create_c",
+                                     INDEX_SYM_CONFIG_CREATE, &probed, &found);
+            destroy = probeSymbol<destroyLib*>(handle, "destroy_c",
+                                               INDEX_SYM_DESTROY,
+                                               &probed, &found);
+            probeSymbol<nameLib*>(handle, "lib_name_c", INDEX_SYM_LIB_NAME,
+                                  &probed, &found);
+        }
+        if(create && destroy) {
+            probed |= INDEX_SYM_CONSTRUCTS;
+            LibInterface *lib = create(manager);
+            if(lib) {
+                found |= INDEX_SYM_CONSTRUCTS;
+                libName = lib->getLibName();
+                version = lib->getLibVersion();
+                lib->createModuleInfo();
+                lib->getModuleInfo();
+                const DependencyInterface *info = getDependencyInterface(lib);
+                if(info) {
+                    info->getDependencies(&dependencies);
+                }
+                // the instance is never destroyed; it goes with the child
+            }
+        }
+    }
+
+    string message;
+    putU32(&message, loaded);
+    putU32(&message, probed);
+    putU32(&message, found);
+    putU32(&message, static_cast<uint32_t>(version));
+    putString(&message, libName);
+    putString(&message, detail);
+    putU32(&message, dependencies.size());
+    for(size_t i = 0; i < dependencies.size(); ++i) {
+        putString(&message, dependencies[i]);
+    }
+    const char *data = message.data();
+    size_t left = message.size();
+    while(left) {
+        ssize_t written = write(fd, data, left);
+        if(written < 0 && errno == EINTR) {
+            continue;
+        }
+        if(written <= 0) {
+            break;
+        }
+        data += written;
+        left -= written;
+    }
+}
+
+/**
+ * Fills result from the message of a child that exited normally.
+ */
+static void parseMessage(const string &message, ProbeResult *result)
+{
+    size_t pos = 0;
+    uint32_t loaded, version, numDependencies = 0;
+    bool ok = (getU32(message, &pos, &loaded) &&
+               getU32(message, &pos, &result->probed) &&
+               getU32(message, &pos, &result->found) &&
+               getU32(message, &pos, &version) &&
+               getString(message, &pos, &result->libName) &&
+               getString(message, &pos, &result->detail) &&
+               getU32(message, &pos, &numDependencies));
+    for(uint32_t i = 0; ok && i < numDependencies; ++i) {
+        result->dependencies.push_back(string());
+        ok = getString(message, &pos, &result->dependencies.back());
+    }
+    if(!ok) {
+        result->status = PROBE_CRASHED;
+        result->detail = "the probe exited early";
+        return;
+    }
+    result->version = static_cast<int32_t>(version);
+    if(!loaded) {
+        result->status = PROBE_NOT_LOADABLE;
+    } else if((result->found & INDEX_SYM_DESCRIPTOR) &&
+              !(result->probed & INDEX_SYM_CONSTRUCTS)) {
+        result->status = PROBE_INCOMPATIBLE;
+    } else if(!(result->probed & INDEX_SYM_CONSTRUCTS)) {
+        result->status = PROBE_MISSING_SYMBOLS;
+        result->detail = "create_c or destroy_c is missing";
+    } else if(!(result->found & INDEX_SYM_CONSTRUCTS)) {
+        result->status = PROBE_NO_INSTANCE;
+        result->detail = "create_c returned NULL";
+    } else {
+        result->status = PROBE_OK;
+    }
+}
+
+struct Worker {
+    pid_t pid;
+    int fd;
+    ProbeResult *result;
+    string message;
+    chrono::steady_clock::time_point deadline;
+};
+
+/**
+ * Waits for the child of worker to end and evaluates what it reported.
+ */
+static void finishWorker(Worker *worker, bool timedOut)
+{
+    close(worker->fd);
+    if(timedOut) {
+        kill(worker->pid, SIGKILL);
+    }
+    int status = 0;
+    while(waitpid(worker->pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    ProbeResult *result = worker->result;
+    if(timedOut) {
+        result->status = PROBE_TIMEOUT;
+        result->detail = "the probe did not finish in time";
+    } else if(WIFSIGNALED(status)) {
+        result->status = PROBE_CRASHED;
+        result->detail = string("the probe was killed by signal ") +
+            to_string(WTERMSIG(status));
+    } else if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        result->status = PROBE_CRASHED;
+        result->detail = string("the probe exited with status ") +
+            to_string(WEXITSTATUS(status));
+    } else {
+        parseMessage(worker->message, result);
+    }
+}
+
+/**
+ * Forks the child for result. Returns false if that is not possible.
+ */
+static bool startWorker(LibManager *manager, ProbeResult *result,
+                        unsigned int timeoutMs, Worker *worker)
+{
+    int fds[2];
+    if(pipe(fds) != 0) {
+        result->detail = strerror(errno);
+        return false;
+    }
+    pid_t pid = fork();
+    if(pid < 0) {
+        result->detail = strerror(errno);
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if(pid == 0) {
+        close(fds[0]);
+        runProbe(manager, result->filepath, fds[1]);
+        // no destructors or atexit handlers of the parent's state
+        _exit(0);
+    }
+    close(fds[1]);
+    worker->pid = pid;
+    worker->fd = fds[0];
+    worker->result = result;
+    worker->deadline = chrono::steady_clock::now() +
+        chrono::milliseconds(timeoutMs);
+    return true;
+}
+
+void probeFiles(LibManager *manager, vector<ProbeResult> *results,
+                unsigned int numWorkers, unsigned int timeoutMs)
+{
+    if(numWorkers < 1) {
+        numWorkers = 1;
+    }
+    vector<Worker> workers;
+    size_t next = 0;
+    while(next < results->size() || !workers.empty()) {
+        while(workers.size() < numWorkers && next < results->size()) {
+            Worker worker;
+            if(startWorker(manager, &(*results)[next], timeoutMs, &worker)) {
+                workers.push_back(worker);
+            }
+            ++next;
+        }
+        if(workers.empty()) {
+            continue;
+        }
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        chrono::steady_clock::time_point deadline = workers[0].deadline;
+        vector<pollfd> fds(workers.size());
+        for(size_t i = 0; i < workers.size(); ++i) {
+            fds[i].fd = workers[i].fd;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+            deadline = min(deadline, workers[i].deadline);
+        }
+        int timeout = 0;
+        if(deadline > now) {
+            timeout = chrono::duration_cast<chrono::milliseconds>(
+                deadline - now).count() + 1;
+        }
+        poll(&fds[0], fds.size(), timeout);
+
+        now = chrono::steady_clock::now();
+        for(size_t i = workers.size(); i-- > 0; ) {
+            Worker &worker = workers[i];
+            bool done = false, timedOut = false;
+            if(fds[i].revents) {
+                char buffer[4096];
+                ssize_t count = read(worker.fd, buffer, sizeof(buffer));
+                if(count > 0) {
+                    worker.message.append(buffer, count);
+                } else if(count == 0 || errno != EINTR) {
+                    done = true;
+                }
+            }
+            if(!done && now >= worker.deadline) {
+                done = timedOut = true;
+            }
+            if(done) {
+                finishWorker(&worker, timedOut);
+                workers.erase(workers.begin() + i);
+            }
+        }
+    }
+}
+
+#endif // WIN32
+
+} // end of namespace lib_manager
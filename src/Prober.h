@@ -0,0 +1,98 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file Prober.h
+ * \brief Tries out library files in child processes.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_PROBER_H
+#define LIB_MANAGER_PROBER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace lib_manager {
+
+    class LibManager;
+
+    enum ProbeStatus {
+        /// The library was constructed.
+        PROBE_OK,
+        /// The probe did not run, e.g. because fork() failed or other
+        /// threads of the manager were running.
+        PROBE_NOT_RUN,
+        /// dlopen() failed.
+        PROBE_NOT_LOADABLE,
+        /// create_c or destroy_c is missing.
+        PROBE_MISSING_SYMBOLS,
+        /// The plugin descriptor does not pass LibManager::checkPlugin().
+        PROBE_INCOMPATIBLE,
+        /// create_c returned NULL.
+        PROBE_NO_INSTANCE,
+        /// The child process crashed or exited early.
+        PROBE_CRASHED,
+        /// The child process did not finish in time and was killed.
+        PROBE_TIMEOUT,
+    };
+
+    struct ProbeResult {
+        ProbeResult() : status(PROBE_NOT_RUN), probed(0), found(0),
+                        version(0) {}
+
+        /// The file to probe.
+        std::string filepath;
+        ProbeStatus status;
+        /// IndexSymbol bits of what was looked up and what was found.
+        uint32_t probed;
+        uint32_t found;
+        /// Results of getLibName(), getLibVersion() and
+        /// DependencyInterface::getDependencies().
+        std::string libName;
+        int32_t version;
+        std::vector<std::string> dependencies;
+        /// What went wrong, if anything.
+        std::string detail;
+    };
+
+    /**
+     * Probes each file in a forked child process: the file is mapped, its
+     * plugin descriptor or factory symbols are looked up and, if they are
+     * there, an instance is created with manager, questioned and abandoned
+     * with the process. A crash, a hang or a failed check in one child only
+     * fails that file.
+     *
+     * At most numWorkers children run at the same time. Must be called
+     * with the load lock of manager held, so that the children do not
+     * inherit a half changed library table, and while no other thread
+     * uses manager: the children are not exec'd, so they would inherit
+     * the locks of such a thread without the thread that releases them.
+     * Not supported on Windows, where every result stays PROBE_NOT_RUN.
+     */
+    void probeFiles(LibManager *manager, std::vector<ProbeResult> *results,
+                    unsigned int numWorkers, unsigned int timeoutMs);
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_PROBER_H */
@@ -0,0 +1,109 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file Reclaimer.cpp
+ * \brief "Reclaimer" queues unused libraries for later destruction.
+ *
+ */
+
+#include "Reclaimer.h"
+
+namespace lib_manager {
+
+using namespace std;
+
+Reclaimer::Reclaimer(const Callback &callback) : callback(callback),
+                                                  stopping(false) {
+}
+
+Reclaimer::~Reclaimer() {
+    stop();
+}
+
+void Reclaimer::push(LibId id)
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        queue.push_back(id);
+    }
+    wake.notify_one();
+}
+
+void Reclaimer::take(vector<LibId> *ids)
+{
+    lock_guard<mutex> lock(queueMutex);
+    if(ids->empty()) {
+        ids->swap(queue);
+    } else {
+        ids->insert(ids->end(), queue.begin(), queue.end());
+        queue.clear();
+    }
+}
+
+void Reclaimer::start()
+{
+    lock_guard<mutex> threadLock(threadMutex);
+    if(thread.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = false;
+    }
+    thread = std::thread(&Reclaimer::run, this);
+}
+
+void Reclaimer::stop()
+{
+    lock_guard<mutex> threadLock(threadMutex);
+    if(!thread.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+/**
+ * The background thread: waits for queued libraries and passes each batch
+ * to the callback, without holding the queue lock.
+ */
+void Reclaimer::run()
+{
+    vector<LibId> batch;
+    unique_lock<mutex> lock(queueMutex);
+    while(true) {
+        wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+        if(stopping) {
+            return;
+        }
+        batch.swap(queue);
+        lock.unlock();
+        callback(batch);
+        batch.clear();
+        lock.lock();
+    }
+}
+
+} // end of namespace lib_manager
@@ -0,0 +1,86 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file Reclaimer.h
+ * \brief "Reclaimer" queues unused libraries for later destruction.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_RECLAIMER_H
+#define LIB_MANAGER_RECLAIMER_H
+
+#include "LibManager.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lib_manager {
+
+    /**
+     * Collects the LibIds of libraries whose last reference was released,
+     * so that they are destroyed later instead of on the releasing thread.
+     * The queue is either emptied with take(), or by a background thread
+     * that hands each batch to the callback.
+     *
+     * All methods are thread safe. The callback must not call stop().
+     */
+    class Reclaimer {
+    public:
+        typedef std::function<void(const std::vector<LibId>&)> Callback;
+
+        explicit Reclaimer(const Callback &callback);
+        ~Reclaimer();
+        Reclaimer(const Reclaimer &) = delete;
+        Reclaimer& operator=(const Reclaimer &) = delete;
+
+        /// Queues id and wakes the background thread, if there is one.
+        void push(LibId id);
+
+        /// Moves everything queued to ids.
+        void take(std::vector<LibId> *ids);
+
+        /// Starts the background thread unless it runs already.
+        void start();
+
+        /// Stops and joins the background thread. The queue is kept.
+        void stop();
+
+    private:
+        Callback callback;
+        std::mutex queueMutex;
+        std::condition_variable wake;
+        std::vector<LibId> queue;
+        bool stopping;
+        /// Serializes start() and stop().
+        std::mutex threadMutex;
+        std::thread thread;
+
+        void run();
+    }; // class Reclaimer
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_RECLAIMER_H */
@@ -0,0 +1,234 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file RefTracker.cpp
+ * \brief "RefTracker" records who holds references to libraries.
+ *
+ */
+
+#include "RefTracker.h"
+#include "LoadTrace.h"
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#  include <execinfo.h>
+#  include <cstdlib>
+#  define LIB_MANAGER_HAVE_BACKTRACE
+#endif
+
+namespace lib_manager {
+
+using namespace std;
+
+static const int maxFrames = 16;
+
+/// The tag of setTag(); a string literal or otherwise never freed.
+static thread_local const char *currentTag = "";
+
+static void addValue(Histogram *histogram, uint64_t value)
+{
+    int bucket = 0;
+    while(value > 1 && bucket < Histogram::NUM_BUCKETS - 1) {
+        value >>= 1;
+        ++bucket;
+    }
+    histogram->buckets[bucket]++;
+}
+
+RefTracker::RefTracker() : enabled(false), sampleEvery(0), numAcquires(0) {
+}
+
+void RefTracker::setEnabled(bool enable, unsigned int theSampleEvery)
+{
+    lock_guard<mutex> lock(trackMutex);
+    sampleEvery = theSampleEvery;
+    if(!enable) {
+        slots.clear();
+    }
+    enabled.store(enable, memory_order_relaxed);
+}
+
+void RefTracker::setTag(const char *tag)
+{
+    currentTag = tag ? tag : "";
+}
+
+/**
+ * Returns the slot for index. A new one starts with untracked references,
+ * the ones that were there before it.
+ */
+RefTracker::Slot& RefTracker::getSlot(uint32_t index, int untracked)
+{
+    unordered_map<uint32_t, Slot>::iterator it = slots.find(index);
+    if(it == slots.end()) {
+        it = slots.emplace(index, Slot()).first;
+        it->second.untracked = untracked > 0 ? untracked : 0;
+    }
+    return it->second;
+}
+
+void RefTracker::acquired(uint32_t index, int references, int64_t lockWait)
+{
+    Holder holder;
+    holder.tag = currentTag;
+    holder.thread = this_thread::get_id();
+    holder.since = traceClock();
+
+    lock_guard<mutex> lock(trackMutex);
+#ifdef LIB_MANAGER_HAVE_BACKTRACE
+    if(sampleEvery && numAcquires % sampleEvery == 0) {
+        void *frames[maxFrames + 1];
+        int numFrames = backtrace(frames, maxFrames + 1);
+        // leave out this function
+        if(numFrames > 1) {
+            holder.frames.assign(frames + 1, frames + numFrames);
+        }
+    }
+#endif
+    ++numAcquires;
+    Slot &slot = getSlot(index, references - 1);
+    if(lockWait >= 0) {
+        addValue(&slot.telemetry.lockWait, lockWait);
+    }
+    slot.acquireRate.count(holder.since, &slot.telemetry.acquireRate);
+    slot.holders.push_back(holder);
+}
+
+void RefTracker::released(uint32_t index, int references, int64_t lockWait)
+{
+    int64_t now = traceClock();
+    const char *tag = currentTag;
+    thread::id self = this_thread::get_id();
+
+    lock_guard<mutex> lock(trackMutex);
+    Slot &slot = getSlot(index, references);
+    if(lockWait >= 0) {
+        addValue(&slot.telemetry.lockWait, lockWait);
+    }
+    slot.releaseRate.count(now, &slot.telemetry.releaseRate);
+    if(slot.untracked > 0) {
+        --slot.untracked;
+        return;
+    }
+
+    vector<Holder> &holders = slot.holders;
+    size_t match = holders.size();
+    for(size_t i = holders.size(); i-- > 0; ) {
+        if(holders[i].tag == tag || !strcmp(holders[i].tag, tag)) {
+            if(holders[i].thread == self) {
+                match = i;
+                break;
+            }
+            if(match == holders.size()) {
+                match = i;
+            }
+        }
+    }
+    if(match == holders.size() && !holders.empty()) {
+        match = holders.size() - 1;
+    }
+    if(match < holders.size()) {
+        addValue(&slot.telemetry.holdTime, now - holders[match].since);
+        holders.erase(holders.begin() + match);
+    }
+}
+
+void RefTracker::forget(uint32_t index)
+{
+    lock_guard<mutex> lock(trackMutex);
+    slots.erase(index);
+}
+
+bool RefTracker::get(uint32_t index, LibTelemetry *telemetry) const
+{
+    int64_t now = traceClock();
+    lock_guard<mutex> lock(trackMutex);
+    unordered_map<uint32_t, Slot>::const_iterator it = slots.find(index);
+    if(it == slots.end()) {
+        return false;
+    }
+    *telemetry = it->second.telemetry;
+    // the current second counts as far as it went
+    if(it->second.acquireRate.calls) {
+        addValue(&telemetry->acquireRate, it->second.acquireRate.calls);
+    }
+    if(it->second.releaseRate.calls) {
+        addValue(&telemetry->releaseRate, it->second.releaseRate.calls);
+    }
+    const vector<Holder> &holders = it->second.holders;
+    telemetry->holders.resize(holders.size());
+    for(size_t i = 0; i < holders.size(); ++i) {
+        RefHolder &holder = telemetry->holders[i];
+        holder.tag = holders[i].tag;
+        holder.age = now - holders[i].since;
+        holder.frames = holders[i].frames;
+    }
+    return true;
+}
+
+void RefTracker::describe(uint32_t index, string *text) const
+{
+    LibTelemetry telemetry;
+    if(!get(index, &telemetry)) {
+        return;
+    }
+    for(size_t i = 0; i < telemetry.holders.size(); ++i) {
+        const RefHolder &holder = telemetry.holders[i];
+        char line[128];
+        snprintf(line, sizeof(line), "      held by \"%s\" for %.3f s\n",
+                 holder.tag.c_str(), holder.age * 1e-9);
+        text->append(line);
+        if(holder.frames.empty()) {
+            continue;
+        }
+#ifdef LIB_MANAGER_HAVE_BACKTRACE
+        char **symbols = backtrace_symbols(&holder.frames[0],
+                                           holder.frames.size());
+        for(size_t f = 0; symbols && f < holder.frames.size(); ++f) {
+            text->append("        ");
+            text->append(symbols[f]);
+            text->append("\n");
+        }
+        free(symbols);
+#endif
+    }
+}
+
+/**
+ * Counts one call in the current second. Once a new second starts, the
+ * count of the previous one goes into the histogram.
+ */
+void RefTracker::Rate::count(int64_t now, Histogram *histogram)
+{
+    int64_t nowSecond = now / 1000000000;
+    if(nowSecond != second) {
+        if(calls) {
+            addValue(histogram, calls);
+        }
+        second = nowSecond;
+        calls = 0;
+    }
+    ++calls;
+}
+
+} // end of namespace lib_manager
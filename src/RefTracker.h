@@ -0,0 +1,130 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file RefTracker.h
+ * \brief "RefTracker" records who holds references to libraries.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_REF_TRACKER_H
+#define LIB_MANAGER_REF_TRACKER_H
+
+#include "LibManager.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace lib_manager {
+
+    /**
+     * The bookkeeping behind LibManager::setRefTracking(): for every slot
+     * of the library table the outstanding references with the tag (and
+     * possibly the call stack) of whoever took them, and the histograms of
+     * LibTelemetry.
+     *
+     * All methods are thread safe. While disabled, the LibManager only
+     * pays for the atomic load in isEnabled().
+     */
+    class RefTracker {
+    public:
+        RefTracker();
+        RefTracker(const RefTracker &) = delete;
+        RefTracker& operator=(const RefTracker &) = delete;
+
+        /// Turns tracking on or off. Turning it off forgets everything.
+        void setEnabled(bool enable, unsigned int sampleEvery);
+        bool isEnabled() const
+        { return enabled.load(std::memory_order_relaxed); }
+
+        /// Sets the tag recorded for references taken by this thread.
+        static void setTag(const char *tag);
+
+        /**
+         * Records a reference taken to the library in slot index, and how
+         * long it took to get the table lock (negative if not measured).
+         * references is the use count with this reference.
+         */
+        void acquired(uint32_t index, int references, int64_t lockWait);
+
+        /**
+         * Records a released reference; references is the use count before
+         * the release. References that were never recorded go first: the
+         * one of the loader and those taken before tracking was turned on.
+         * After them the holder that goes is the latest one taken by this
+         * thread with its current tag, or else the latest one with that
+         * tag, or else the latest one.
+         */
+        void released(uint32_t index, int references, int64_t lockWait);
+
+        /// Drops everything recorded for the slot, which is being freed.
+        void forget(uint32_t index);
+
+        /// Returns false if nothing was recorded for the slot.
+        bool get(uint32_t index, LibTelemetry *telemetry) const;
+
+        /// Appends one line per holder, with symbolized frames if possible.
+        void describe(uint32_t index, std::string *text) const;
+
+    private:
+        struct Holder {
+            const char *tag;
+            std::thread::id thread;
+            int64_t since;
+            std::vector<void*> frames;
+        };
+
+        struct Rate {
+            Rate() : second(0), calls(0) {}
+            void count(int64_t now, Histogram *histogram);
+
+            int64_t second;
+            uint64_t calls;
+        };
+
+        struct Slot {
+            Slot() : untracked(0) {}
+
+            /// The use count when the slot was first seen, minus the
+            /// references that were released since.
+            int untracked;
+            std::vector<Holder> holders;
+            LibTelemetry telemetry;
+            Rate acquireRate, releaseRate;
+        };
+
+        std::atomic<bool> enabled;
+        /// Take a call stack on every sampleEvery-th acquire, 0 for never.
+        unsigned int sampleEvery;
+        uint64_t numAcquires;
+        std::unordered_map<uint32_t, Slot> slots;
+        mutable std::mutex trackMutex;
+
+        Slot& getSlot(uint32_t index, int untracked);
+    }; // class RefTracker
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_REF_TRACKER_H */
@@ -0,0 +1,80 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file SlabPool.h
+ * \brief "SlabPool" stores objects in fixed-size blocks that never move.
+ *
+ * This header is installed because LibManager.h uses it; plugins do not
+ * need it.
+ */
+
+#ifndef LIB_MANAGER_SLAB_POOL_H
+#define LIB_MANAGER_SLAB_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace lib_manager {
+
+    /**
+     * An array that grows by whole slabs of SlabSize default constructed
+     * objects. Growing never moves existing objects, so their addresses
+     * stay valid until clear(), and neighbouring indices are neighbours in
+     * memory.
+     */
+    template <typename T, size_t SlabSize = 64>
+    class SlabPool {
+    public:
+        SlabPool() : count(0) {}
+        SlabPool(const SlabPool &) = delete;
+        SlabPool& operator=(const SlabPool &) = delete;
+
+        size_t size() const
+        { return count; }
+
+        T& operator[](size_t i)
+        { return slabs[i / SlabSize][i % SlabSize]; }
+        const T& operator[](size_t i) const
+        { return slabs[i / SlabSize][i % SlabSize]; }
+
+        /// Appends one object and returns its index.
+        size_t grow() {
+            if(count == slabs.size() * SlabSize) {
+                slabs.push_back(std::unique_ptr<T[]>(new T[SlabSize]));
+            }
+            return count++;
+        }
+
+        /// Destroys all objects, freeing every slab at once.
+        void clear() {
+            slabs.clear();
+            count = 0;
+        }
+
+    private:
+        std::vector<std::unique_ptr<T[]> > slabs;
+        size_t count;
+    }; // class SlabPool
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_SLAB_POOL_H */
@@ -0,0 +1,154 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file ThreadPool.cpp
+ * \brief "ThreadPool" spreads independent work items over a few threads.
+ *
+ */
+
+#include "ThreadPool.h"
+
+namespace lib_manager {
+
+using namespace std;
+
+ThreadPool::ThreadPool() : stopping(false), job(NULL), jobNumber(0),
+                           jobCount(0), freeSeats(0), active(0), next(0) {
+}
+
+ThreadPool::~ThreadPool() {
+    stopWorkers();
+}
+
+void ThreadPool::resize(unsigned int numThreads)
+{
+    lock_guard<mutex> jobLock(jobMutex);
+    size_t numWorkers = numThreads > 1 ? numThreads - 1 : 0;
+    if(numWorkers == workers.size()) {
+        return;
+    }
+    stopWorkers();
+    stopping = false;
+    for(size_t i = 0; i < numWorkers; ++i) {
+        workers.push_back(thread(&ThreadPool::run, this));
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, unsigned int numThreads,
+                             const Func &func)
+{
+    unique_lock<mutex> jobLock(jobMutex, try_to_lock);
+    if(numThreads < 2 || count < 2 || !jobLock.owns_lock() ||
+       workers.empty()) {
+        for(size_t i = 0; i < count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(poolMutex);
+        job = &func;
+        ++jobNumber;
+        jobCount = count;
+        freeSeats = (unsigned int)min(min((size_t)numThreads, count) - 1,
+                                      workers.size());
+        error = nullptr;
+        next = 0;
+    }
+    wake.notify_all();
+    runItems();
+
+    exception_ptr failure;
+    {
+        unique_lock<mutex> lock(poolMutex);
+        done.wait(lock, [this]() { return active == 0; });
+        // workers that did not join yet must not find the job
+        job = NULL;
+        freeSeats = 0;
+        failure = error;
+        error = nullptr;
+    }
+    if(failure) {
+        rethrow_exception(failure);
+    }
+}
+
+/**
+ * Works on the items of the current job until none are left. Called
+ * without the lock, while job stays valid.
+ */
+void ThreadPool::runItems()
+{
+    size_t i;
+    while((i = next.fetch_add(1)) < jobCount) {
+        try {
+            (*job)(i);
+        } catch(...) {
+            lock_guard<mutex> lock(poolMutex);
+            if(!error) {
+                error = current_exception();
+            }
+            next = jobCount;
+        }
+    }
+}
+
+void ThreadPool::run()
+{
+    unique_lock<mutex> lock(poolMutex);
+    unsigned long lastJob = 0;
+    while(true) {
+        wake.wait(lock, [&]() {
+                return stopping || (job && jobNumber != lastJob &&
+                                    freeSeats > 0);
+            });
+        if(stopping) {
+            return;
+        }
+        lastJob = jobNumber;
+        --freeSeats;
+        ++active;
+        lock.unlock();
+        runItems();
+        lock.lock();
+        if(--active == 0) {
+            done.notify_all();
+        }
+    }
+}
+
+/// Stops and joins all workers. Must be called with jobMutex held or
+/// from the destructor.
+void ThreadPool::stopWorkers()
+{
+    {
+        lock_guard<mutex> lock(poolMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+    workers.clear();
+}
+
+} // end of namespace lib_manager
@@ -0,0 +1,109 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file ThreadPool.h
+ * \brief "ThreadPool" spreads independent work items over a few threads.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_THREAD_POOL_H
+#define LIB_MANAGER_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lib_manager {
+
+    /**
+     * Worker threads that are started once and then take part in every
+     * parallelFor(), so that a batch of loads or destroys does not pay
+     * for creating threads.
+     *
+     * All methods are thread safe. One parallelFor() runs on the workers
+     * at a time; a call made while the workers are busy, e.g. from one of
+     * the items, runs on its calling thread only.
+     */
+    class ThreadPool {
+    public:
+        typedef std::function<void(size_t)> Func;
+
+        ThreadPool();
+        ~ThreadPool();
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool& operator=(const ThreadPool &) = delete;
+
+        /**
+         * Keeps numThreads - 1 workers, since the calling thread of
+         * parallelFor() takes part in the work. Waits for a running
+         * parallelFor().
+         */
+        void resize(unsigned int numThreads);
+
+        /**
+         * Calls func(i) for every i in [0, count) using up to numThreads
+         * threads, the calling thread included. If numThreads is smaller
+         * than two or there is only one item, everything runs on the
+         * calling thread in ascending order. If func throws, no further
+         * items are started and the first exception is rethrown here
+         * once the items already started are done.
+         */
+        void parallelFor(size_t count, unsigned int numThreads,
+                         const Func &func);
+
+    private:
+        std::vector<std::thread> workers;
+        /// Held for a whole parallelFor() and by resize().
+        std::mutex jobMutex;
+
+        /// Guards everything below.
+        std::mutex poolMutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        bool stopping;
+        /// The running job, NULL between jobs.
+        const Func *job;
+        /// Incremented for every job, so that a worker joins it only once.
+        unsigned long jobNumber;
+        size_t jobCount;
+        /// Workers that may still join the job.
+        unsigned int freeSeats;
+        /// Workers that are working on the job.
+        unsigned int active;
+        std::exception_ptr error;
+
+        std::atomic<size_t> next;
+
+        void run();
+        void runItems();
+        void stopWorkers();
+    }; // class ThreadPool
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_THREAD_POOL_H */
@@ -0,0 +1,175 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file Warmup.cpp
+ * \brief Gets library files into memory before and while they are mapped.
+ *
+ */
+
+#include "Warmup.h"
+
+#ifdef WIN32
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+#if defined(__linux__)
+#  include <dlfcn.h>
+#  include <link.h>
+#  include <sys/mman.h>
+#  include <cstring>
+#endif
+
+namespace lib_manager {
+
+using namespace std;
+
+#ifdef WIN32
+
+void prefetchFile(const string &filepath)
+{
+#if _WIN32_WINNT >= 0x0602
+    HANDLE file = CreateFile(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                             NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if(!mapping) {
+        return;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if(!view) {
+        return;
+    }
+    MEMORY_BASIC_INFORMATION info;
+    if(VirtualQuery(view, &info, sizeof(info))) {
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = view;
+        range.NumberOfBytes = info.RegionSize;
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+    // the pages stay in the standby list after the view is gone
+    UnmapViewOfFile(view);
+#else
+    (void)filepath;
+#endif
+}
+
+bool lockLibrary(void *handle)
+{
+    // a module handle is the address the image is mapped at
+    const char *base = static_cast<const char*>(handle);
+    const IMAGE_DOS_HEADER *dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+    const IMAGE_NT_HEADERS *nt =
+        reinterpret_cast<const IMAGE_NT_HEADERS*>(base + dos->e_lfanew);
+    SIZE_T size = nt->OptionalHeader.SizeOfImage;
+    SIZE_T minSize, maxSize;
+    HANDLE process = GetCurrentProcess();
+    // VirtualLock is limited by the working set, so make room first
+    if(GetProcessWorkingSetSize(process, &minSize, &maxSize)) {
+        SetProcessWorkingSetSize(process, minSize + size, maxSize + size);
+    }
+    return VirtualLock(const_cast<char*>(base), size) != 0;
+}
+
+#else // WIN32
+
+void prefetchFile(const string &filepath)
+{
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return;
+    }
+#if defined(__APPLE__)
+    struct stat st;
+    if(fstat(fd, &st) == 0) {
+        struct radvisory advice;
+        advice.ra_offset = 0;
+        advice.ra_count = st.st_size;
+        fcntl(fd, F_RDADVISE, &advice);
+    }
+#elif defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+    close(fd);
+}
+
+#if defined(__linux__)
+struct LockRequest {
+    const link_map *map;
+    bool found;
+    bool locked;
+};
+
+/**
+ * dl_iterate_phdr() callback: locks the loaded segments of the object that
+ * request->map describes.
+ */
+static int lockSegments(struct dl_phdr_info *info, size_t, void *data)
+{
+    LockRequest *request = static_cast<LockRequest*>(data);
+    if(info->dlpi_addr != request->map->l_addr || !info->dlpi_name ||
+       strcmp(info->dlpi_name, request->map->l_name) != 0) {
+        return 0;
+    }
+    request->found = true;
+    const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    for(int i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+        if(phdr.p_type != PT_LOAD) {
+            continue;
+        }
+        uintptr_t start = info->dlpi_addr + phdr.p_vaddr;
+        uintptr_t end = start + phdr.p_memsz;
+        start &= ~(pageSize - 1);
+        if(mlock(reinterpret_cast<void*>(start), end - start) != 0) {
+            request->locked = false;
+        }
+    }
+    return 1;
+}
+
+bool lockLibrary(void *handle)
+{
+    link_map *map = NULL;
+    if(dlinfo(handle, RTLD_DI_LINKMAP, &map) != 0 || !map) {
+        return false;
+    }
+    LockRequest request = { map, false, true };
+    dl_iterate_phdr(&lockSegments, &request);
+    return request.found && request.locked;
+}
+#else
+bool lockLibrary(void *handle)
+{
+    (void)handle;
+    return false;
+}
+#endif
+
+#endif // WIN32
+
+} // end of namespace lib_manager
@@ -0,0 +1,56 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file Warmup.h
+ * \brief Gets library files into memory before and while they are mapped.
+ *
+ * This header is not installed; it is only used by the LibManager
+ * implementation.
+ */
+
+#ifndef LIB_MANAGER_WARMUP_H
+#define LIB_MANAGER_WARMUP_H
+
+#include <string>
+
+namespace lib_manager {
+
+    /**
+     * Asks the OS to read the file into the page cache in the background
+     * (posix_fadvise(WILLNEED), F_RDADVISE on macOS, PrefetchVirtualMemory
+     * on Windows). Returns right away; errors are ignored, as the file is
+     * only read earlier than it would be anyway.
+     */
+    void prefetchFile(const std::string &filepath);
+
+    /**
+     * Faults in all pages of a mapped library and locks them in memory,
+     * so that running its code never waits for the disk. The lock ends
+     * when the library is unmapped.
+     * @param handle A handle returned by dlopen() or LoadLibrary().
+     * @return false if the library could not be locked, e.g. because of
+     *         RLIMIT_MEMLOCK, or if this is not supported here.
+     */
+    bool lockLibrary(void *handle);
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_WARMUP_H */
@@ -0,0 +1,253 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file TestHelpers.h
+ * \brief Libraries and listeners shared by the tests.
+ *
+ */
+
+#ifndef LIB_MANAGER_TEST_HELPERS_H
+#define LIB_MANAGER_TEST_HELPERS_H
+
+#include "LibManager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ftw.h>
+#include <unistd.h>
+
+namespace lib_manager {
+
+    /// The file of a plugin built by add_test_plugin().
+    inline std::string pluginPath(const std::string &name)
+    {
+        // CMake names MODULE libraries .so on macOS as well
+        return std::string(LIB_MANAGER_TEST_PLUGIN_DIR) + "/lib" + name + ".so";
+    }
+
+    /**
+     * Copies the file of a plugin into dir and returns the path of the copy.
+     * The copy has the name of the original unless fileName is given.
+     */
+    inline std::string copyPlugin(const std::string &name,
+                                  const std::string &dir,
+                                  const std::string &fileName = "")
+    {
+        std::string copy = dir + "/" +
+            (fileName.empty() ? "lib" + name + ".so" : fileName);
+        std::ifstream from(pluginPath(name).c_str(), std::ios::binary);
+        std::ofstream to(copy.c_str(), std::ios::binary);
+        to << from.rdbuf();
+        return copy;
+    }
+
+    /// Sets LD_LIBRARY_PATH for one test and restores it afterwards.
+    class SearchPath {
+    public:
+        SearchPath() : wasSet(getenv("LD_LIBRARY_PATH") != NULL)
+        {
+            if(wasSet) {
+                old = getenv("LD_LIBRARY_PATH");
+            }
+        }
+
+        ~SearchPath()
+        {
+            if(wasSet) {
+                setenv("LD_LIBRARY_PATH", old.c_str(), 1);
+            } else {
+                unsetenv("LD_LIBRARY_PATH");
+            }
+        }
+
+        void set(const std::string &value)
+        { setenv("LD_LIBRARY_PATH", value.c_str(), 1); }
+
+    private:
+        bool wasSet;
+        std::string old;
+    };
+
+    /// A new directory under /tmp that is removed with everything in it.
+    class TempDir {
+    public:
+        TempDir()
+        {
+            char name[] = "/tmp/lib_manager_test_XXXXXX";
+            if(mkdtemp(name)) {
+                dirPath = name;
+            }
+        }
+
+        ~TempDir()
+        {
+            if(!dirPath.empty()) {
+                nftw(dirPath.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+            }
+        }
+
+        const std::string& path() const
+        { return dirPath; }
+
+    private:
+        std::string dirPath;
+
+        static int removeEntry(const char *path, const struct stat *,
+                               int, struct FTW *)
+        { return remove(path); }
+    };
+
+    /**
+     * A library registered with addLibrary(). Like TestPlugin it can hold
+     * another library from construction to destruction, and it counts its
+     * destructions in destroyed.
+     */
+    class TestLib : public LibInterface {
+    public:
+        TestLib(LibManager *theManager, const std::string &name,
+                std::atomic<int> *destroyed, const std::string &holds = "")
+            : LibInterface(theManager), name(name), holds(holds),
+              destroyed(destroyed)
+        {
+            if(!holds.empty() && !libManager->acquireLibrary(holds)) {
+                this->holds.clear();
+            }
+        }
+
+        ~TestLib()
+        {
+            if(!holds.empty()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                libManager->releaseLibrary(holds);
+            }
+            ++*destroyed;
+        }
+
+        int getLibVersion() const
+        { return 1; }
+        const std::string getLibName() const
+        { return name; }
+
+        CREATE_MODULE_INFO();
+
+        /// The destroy function to pass to addLibrary().
+        static void* destroy(LibInterface *lib)
+        {
+            delete lib;
+            return NULL;
+        }
+
+    private:
+        std::string name;
+        std::string holds;
+        std::atomic<int> *destroyed;
+    };
+
+    /// Records the LoadEvents of one type.
+    class EventLog : public LibManager::LoadListener {
+    public:
+        explicit EventLog(LibManager::LoadEventType type) : type(type) {}
+
+        void loadEvent(const LibManager::LoadEvent &event)
+        {
+            if(event.type == type) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                names.push_back(event.libName);
+                filepaths.push_back(event.filepath);
+            }
+        }
+
+        /// The file of the last event, or "".
+        std::string lastFilepath() const
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            return filepaths.empty() ? std::string() : filepaths.back();
+        }
+
+        /// How often the event happened for libName.
+        int count(const std::string &libName) const
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            int n = 0;
+            for(size_t i = 0; i < names.size(); ++i) {
+                n += (names[i] == libName);
+            }
+            return n;
+        }
+
+    private:
+        LibManager::LoadEventType type;
+        std::vector<std::string> names;
+        std::vector<std::string> filepaths;
+        mutable std::mutex logMutex;
+    };
+
+    /// Records the messages of a manager, see LibManager::setLogSink().
+    class MessageLog : public LibManager::LogSink {
+    public:
+        void log(LibManager::LogLevel level, const char *message)
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            levels.push_back(level);
+            messages.push_back(message);
+        }
+
+        /// The messages that contain text, in the order they were logged.
+        std::vector<std::string> find(const std::string &text) const
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::vector<std::string> found;
+            for(size_t i = 0; i < messages.size(); ++i) {
+                if(messages[i].find(text) != std::string::npos) {
+                    found.push_back(messages[i]);
+                }
+            }
+            return found;
+        }
+
+        /// The most verbose level that was logged, or -1.
+        int maxLevel() const
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            int level = -1;
+            for(size_t i = 0; i < levels.size(); ++i) {
+                level = std::max(level, (int)levels[i]);
+            }
+            return level;
+        }
+
+    private:
+        std::vector<LibManager::LogLevel> levels;
+        std::vector<std::string> messages;
+        mutable std::mutex logMutex;
+    };
+
+} // end of namespace lib_manager
+
+#endif /* LIB_MANAGER_TEST_HELPERS_H */
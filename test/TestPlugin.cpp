@@ -0,0 +1,96 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * \file TestPlugin.cpp
+ * \brief The plugin libraries used by the test suite.
+ *
+ * TEST_PLUGIN_NAME is the library name. If TEST_PLUGIN_HOLDS is defined,
+ * the plugin acquires that library when it is created and releases it
+ * when it is destroyed. With TEST_PLUGIN_DEPENDS it declares a dependency
+ * on that library through DependencyInterface. With TEST_PLUGIN_DESCRIPTOR
+ * the factories are exported through a PluginDescriptor instead of the
+ * single symbols.
+ * While the environment variable TEST_PLUGIN_HANG is set, creating any of
+ * the plugins hangs for a minute.
+ */
+
+#include "LibInterface.h"
+#include "LibManager.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+namespace lib_manager {
+
+    class TestPlugin : public LibInterface
+#ifdef TEST_PLUGIN_DEPENDS
+                     , public DependencyInterface
+#endif
+    {
+    public:
+        TestPlugin(LibManager *theManager)
+            : LibInterface(theManager), held(false)
+        {
+            if(getenv("TEST_PLUGIN_HANG")) {
+                std::this_thread::sleep_for(std::chrono::minutes(1));
+            }
+#ifdef TEST_PLUGIN_HOLDS
+            held = (libManager->acquireLibrary(TEST_PLUGIN_HOLDS) != NULL);
+#endif
+        }
+
+        ~TestPlugin()
+        {
+#ifdef TEST_PLUGIN_HOLDS
+            if(held) {
+                // long enough for parallel destroy functions to overlap
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                libManager->releaseLibrary(TEST_PLUGIN_HOLDS);
+            }
+#endif
+        }
+
+        int getLibVersion() const
+        { return 1; }
+        const std::string getLibName() const
+        { return TEST_PLUGIN_NAME; }
+
+#ifdef TEST_PLUGIN_DEPENDS
+        void getDependencies(std::vector<std::string> *libNames) const
+        { libNames->push_back(TEST_PLUGIN_DEPENDS); }
+#endif
+
+        CREATE_MODULE_INFO();
+
+    private:
+        bool held;
+    };
+
+} // end of namespace lib_manager
+
+#ifdef TEST_PLUGIN_DESCRIPTOR
+CREATE_PLUGIN_DESCRIPTOR(lib_manager::TestPlugin, TEST_PLUGIN_NAME, 1)
+#else
+DESTROY_LIB(lib_manager::TestPlugin);
+CREATE_LIB(lib_manager::TestPlugin);
+DECLARE_LIB_NAME(TEST_PLUGIN_NAME);
+#endif
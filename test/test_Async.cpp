@@ -0,0 +1,115 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <fstream>
+#include <future>
+
+using namespace lib_manager;
+
+/// Records the paths of the failed loads.
+class FailureLog : public LibManager::LoadListener {
+public:
+    void loadEvent(const LibManager::LoadEvent &event)
+    {
+        if(event.type == LibManager::LIBMGR_EVENT_FAILED) {
+            std::lock_guard<std::mutex> lock(logMutex);
+            libPaths.push_back(event.libPath);
+            errors.push_back(event.error);
+        }
+    }
+
+    std::vector<std::string> libPaths;
+    std::vector<LibManager::ErrorNumber> errors;
+    std::mutex logMutex;
+};
+
+BOOST_AUTO_TEST_CASE(async_load_reports_every_step)
+{
+    LibManager manager;
+    EventLog resolved(LibManager::LIBMGR_EVENT_RESOLVED);
+    EventLog mapped(LibManager::LIBMGR_EVENT_MAPPED);
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    EventLog registered(LibManager::LIBMGR_EVENT_REGISTERED);
+    manager.addLoadListener(&resolved);
+    manager.addLoadListener(&mapped);
+    manager.addLoadListener(&constructed);
+    manager.addLoadListener(&registered);
+
+    std::future<LibManager::ErrorNumber> result =
+        manager.loadLibraryAsync(pluginPath("test_plain"));
+    BOOST_CHECK_EQUAL(result.get(), LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK(manager.getLibraryId("test_plain").isValid());
+    BOOST_CHECK_EQUAL(resolved.lastFilepath(), pluginPath("test_plain"));
+    BOOST_CHECK_EQUAL(mapped.lastFilepath(), pluginPath("test_plain"));
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 1);
+    BOOST_CHECK_EQUAL(registered.count("test_plain"), 1);
+
+    manager.removeLoadListener(&resolved);
+    manager.removeLoadListener(&mapped);
+    manager.removeLoadListener(&constructed);
+    manager.removeLoadListener(&registered);
+    manager.releaseLibrary("test_plain");
+}
+
+BOOST_AUTO_TEST_CASE(failed_async_load_reports_the_error)
+{
+    const std::string missingPath = "/nonexistent/libno_such_plugin.so";
+    LibManager manager;
+    FailureLog failures;
+    manager.addLoadListener(&failures);
+    std::future<LibManager::ErrorNumber> result =
+        manager.loadLibraryAsync(missingPath);
+    BOOST_CHECK_EQUAL(result.get(), LibManager::LIBMGR_ERR_NOT_ABLE_TO_LOAD);
+    BOOST_REQUIRE_EQUAL(failures.libPaths.size(), 1u);
+    BOOST_CHECK_EQUAL(failures.libPaths[0], missingPath);
+    BOOST_CHECK_EQUAL(failures.errors[0],
+                      LibManager::LIBMGR_ERR_NOT_ABLE_TO_LOAD);
+    manager.removeLoadListener(&failures);
+}
+
+BOOST_AUTO_TEST_CASE(manager_waits_for_async_loads)
+{
+    TempDir dir;
+    const std::string config = dir.path() + "/plugins.txt";
+    {
+        std::ofstream out(config.c_str());
+        out << pluginPath("test_plain") << "\n";
+        out << pluginPath("test_descriptor") << "\n";
+    }
+    std::future<LibManager::ErrorNumber> library;
+    std::future<void> configFile;
+    {
+        LibManager manager;
+        // the libraries are still referenced by the loader when it goes
+        manager.setLogLevel(LibManager::LIBMGR_LOG_ERROR);
+        library = manager.loadLibraryAsync(pluginPath("test_dependent"));
+        configFile = manager.loadConfigFileAsync(config);
+    }
+    // both were done before the manager went away
+    BOOST_CHECK(library.wait_for(std::chrono::seconds(0)) ==
+                std::future_status::ready);
+    BOOST_CHECK(configFile.wait_for(std::chrono::seconds(0)) ==
+                std::future_status::ready);
+    BOOST_CHECK_EQUAL(library.get(), LibManager::LIBMGR_NO_ERROR);
+    configFile.get();
+}
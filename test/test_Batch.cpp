@@ -0,0 +1,115 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace lib_manager;
+
+BOOST_AUTO_TEST_CASE(batch_acquire_skips_missing_libraries)
+{
+    std::atomic<int> destroyed(0);
+    LibManager manager;
+    manager.addLibrary(new TestLib(&manager, "lib_1", &destroyed),
+                       TestLib::destroy);
+    manager.addLibrary(new TestLib(&manager, "lib_2", &destroyed),
+                       TestLib::destroy);
+
+    const std::string names[] = {"lib_1", "no_such_lib", "lib_2"};
+    LibInterface *libs[3];
+    LibId ids[3];
+    BOOST_CHECK_EQUAL(manager.acquireLibraries(names, 3, libs, ids), 2u);
+    BOOST_REQUIRE(libs[0] && libs[2]);
+    BOOST_CHECK_EQUAL(libs[0]->getLibName(), "lib_1");
+    BOOST_CHECK(!libs[1]);
+    BOOST_CHECK_EQUAL(libs[2]->getLibName(), "lib_2");
+    BOOST_CHECK(ids[0] == manager.getLibraryId("lib_1"));
+    BOOST_CHECK(!ids[1].isValid());
+    BOOST_CHECK_EQUAL(LibManager::getLastError().error,
+                      LibManager::LIBMGR_ERR_NO_LIBRARY);
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("lib_1").references, 2);
+
+    // the invalid id is skipped
+    BOOST_CHECK_EQUAL(manager.releaseLibraries(ids, 3), 2u);
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("lib_1").references, 1);
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("lib_2").references, 1);
+
+    const std::string all[] = {"lib_1", "lib_2"};
+    BOOST_CHECK_EQUAL(manager.releaseLibraries(all, 2), 2u);
+    BOOST_CHECK_EQUAL(destroyed, 2);
+}
+
+BOOST_AUTO_TEST_CASE(batch_acquire_constructs_lazy_plugins)
+{
+    LibManager manager;
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    manager.addLoadListener(&constructed);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain"), NULL,
+                                            NULL, LibManager::LIBMGR_LOAD_LAZY),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_descriptor")),
+                        LibManager::LIBMGR_NO_ERROR);
+
+    LibId ids[2] = {manager.getLibraryId("test_plain"),
+                    manager.getLibraryId("test_descriptor")};
+    LibInterface *libs[2];
+    BOOST_CHECK_EQUAL(manager.acquireLibraries(ids, 2, libs), 2u);
+    BOOST_REQUIRE(libs[0] && libs[1]);
+    BOOST_CHECK_EQUAL(libs[0]->getLibName(), "test_plain");
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 1);
+
+    BOOST_CHECK_EQUAL(manager.releaseLibraries(ids, 2), 2u);
+    BOOST_CHECK_EQUAL(manager.releaseLibraries(ids, 2), 2u);
+    BOOST_CHECK(!manager.getLibraryId("test_plain").isValid());
+    BOOST_CHECK(!manager.getLibraryId("test_descriptor").isValid());
+    manager.removeLoadListener(&constructed);
+}
+
+BOOST_AUTO_TEST_CASE(batch_release_unloads_dependents_first)
+{
+    TempDir dir;
+    const std::string traceFile = dir.path() + "/trace.json";
+    LibManager manager;
+    std::vector<std::string> libPaths;
+    libPaths.push_back(pluginPath("test_plain"));
+    libPaths.push_back(pluginPath("test_dependent"));
+    manager.loadLibraries(libPaths);
+    manager.setTracing(true);
+
+    const std::string names[] = {"test_plain", "test_dependent"};
+    BOOST_CHECK_EQUAL(manager.releaseLibraries(names, 2), 2u);
+    BOOST_CHECK(!manager.getLibraryId("test_plain").isValid());
+    BOOST_CHECK(!manager.getLibraryId("test_dependent").isValid());
+
+    // only the destroy steps are traced, in the order they ran
+    BOOST_REQUIRE(manager.writeTrace(traceFile));
+    std::ifstream in(traceFile.c_str());
+    std::stringstream text;
+    text << in.rdbuf();
+    const std::string trace = text.str();
+    const size_t dependent = trace.find("\"lib\":\"test_dependent\"");
+    const size_t plain = trace.find("\"lib\":\"test_plain\"");
+    BOOST_REQUIRE(dependent != std::string::npos);
+    BOOST_REQUIRE(plain != std::string::npos);
+    BOOST_CHECK(dependent < plain);
+}
@@ -0,0 +1,126 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <thread>
+
+using namespace lib_manager;
+
+static const int numThreads = 4;
+static const int numRounds = 50;
+
+BOOST_AUTO_TEST_CASE(acquires_and_releases_race_with_loads_and_unloads)
+{
+    std::atomic<int> destroyed(0);
+    LibManager manager;
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    manager.addLibrary(new TestLib(&manager, "stable", &destroyed),
+                       TestLib::destroy);
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < numThreads; ++t) {
+        threads.push_back(std::thread([&]() {
+                    while(!stop) {
+                        LibInterface *lib = manager.acquireLibrary("stable");
+                        if(!lib || lib->getLibName() != "stable") {
+                            ++failures;
+                        }
+                        manager.releaseLibrary("stable");
+                        lib = manager.acquireLibrary("test_plain");
+                        if(!lib) {
+                            ++failures;
+                        }
+                        manager.releaseLibrary("test_plain");
+                        // comes and goes; either there or cleanly not
+                        lib = manager.acquireLibrary("churn");
+                        if(lib) {
+                            if(lib->getLibName() != "churn") {
+                                ++failures;
+                            }
+                            manager.releaseLibrary("churn");
+                        }
+                        // give the writer a chance on small machines
+                        std::this_thread::yield();
+                    }
+                }));
+    }
+
+    for(int i = 0; i < numRounds; ++i) {
+        manager.addLibrary(new TestLib(&manager, "churn", &destroyed),
+                           TestLib::destroy);
+        manager.releaseLibrary("churn");
+        BOOST_CHECK_EQUAL(manager.loadLibrary(pluginPath("test_descriptor")),
+                          LibManager::LIBMGR_NO_ERROR);
+        manager.releaseLibrary("test_descriptor");
+    }
+    stop = true;
+    for(size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+
+    BOOST_CHECK_EQUAL(failures, 0);
+    BOOST_CHECK_EQUAL(destroyed, numRounds);
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("stable").references, 1);
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_plain").references, 1);
+    BOOST_CHECK(!manager.getLibraryId("churn").isValid());
+    manager.releaseLibrary("stable");
+    manager.releaseLibrary("test_plain");
+}
+
+BOOST_AUTO_TEST_CASE(lazy_plugin_acquired_by_many_threads_is_constructed_once)
+{
+    LibManager manager;
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    manager.addLoadListener(&constructed);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain"), NULL,
+                                            NULL, LibManager::LIBMGR_LOAD_LAZY),
+                        LibManager::LIBMGR_NO_ERROR);
+
+    std::atomic<int> waiting(numThreads);
+    std::vector<LibInterface*> libs(numThreads);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < numThreads; ++t) {
+        threads.push_back(std::thread([&, t]() {
+                    // start acquiring at the same time
+                    --waiting;
+                    while(waiting > 0) {
+                        std::this_thread::yield();
+                    }
+                    libs[t] = manager.acquireLibrary("test_plain");
+                }));
+    }
+    for(size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 1);
+    for(int t = 0; t < numThreads; ++t) {
+        BOOST_CHECK(libs[t] && libs[t] == libs[0]);
+        manager.releaseLibrary("test_plain");
+    }
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_plain").references, 1);
+    manager.releaseLibrary("test_plain");
+    manager.removeLoadListener(&constructed);
+}
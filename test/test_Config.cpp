@@ -0,0 +1,63 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace lib_manager;
+
+BOOST_AUTO_TEST_CASE(unquoted_paths_can_contain_whitespace)
+{
+    char tmpl[] = "/tmp/lib_manager_test_XXXXXX";
+    BOOST_REQUIRE(mkdtemp(tmpl));
+    const std::string dir = std::string(tmpl) + "/my plugins";
+    BOOST_REQUIRE(mkdir(dir.c_str(), 0700) == 0);
+    const std::string plain = copyPlugin("test_plain", dir);
+    const std::string descriptor = copyPlugin("test_descriptor", dir);
+    const std::string config = std::string(tmpl) + "/plugins.txt";
+    {
+        std::ofstream out(config.c_str());
+        out << plain << "\n";
+        out << "  " << descriptor << "   lazy \n";
+    }
+
+    LibManager manager;
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    manager.addLoadListener(&constructed);
+    manager.loadConfigFile(config);
+    BOOST_CHECK(manager.getLibraryId("test_plain").isValid());
+    BOOST_CHECK(manager.getLibraryId("test_descriptor").isValid());
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 1);
+    BOOST_CHECK_EQUAL(constructed.count("test_descriptor"), 0);
+    manager.removeLoadListener(&constructed);
+    manager.clearLibraries();
+
+    remove(plain.c_str());
+    remove(descriptor.c_str());
+    remove(config.c_str());
+    rmdir(dir.c_str());
+    rmdir(tmpl);
+}
@@ -0,0 +1,48 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <cstdio>
+
+using namespace lib_manager;
+
+BOOST_AUTO_TEST_CASE(load_order_follows_the_dependency_interface)
+{
+    const std::string indexFile = "test_dependent.index";
+    std::vector<std::string> libPaths;
+    libPaths.push_back(pluginPath("test_dependent"));
+    libPaths.push_back(pluginPath("test_plain"));
+    {
+        LibManager manager;
+        manager.loadLibraries(libPaths);
+        BOOST_REQUIRE(manager.getLibraryId("test_dependent").isValid());
+        BOOST_REQUIRE(manager.writeIndex(indexFile));
+    }
+    LibManager manager;
+    BOOST_REQUIRE(manager.readIndex(indexFile));
+    std::vector<std::vector<std::string> > levels;
+    manager.getLoadOrder(libPaths, &levels);
+    BOOST_REQUIRE_EQUAL(levels.size(), 2u);
+    BOOST_CHECK(levels[0] == std::vector<std::string>(1, libPaths[1]));
+    BOOST_CHECK(levels[1] == std::vector<std::string>(1, libPaths[0]));
+    remove(indexFile.c_str());
+}
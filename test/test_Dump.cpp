@@ -0,0 +1,116 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace lib_manager;
+
+/// A name that needs escaping in XML and in JSON.
+static const char *oddName = "a<b>&\"c\"";
+
+BOOST_AUTO_TEST_CASE(xml_and_json_dumps_escape_the_names)
+{
+    std::atomic<int> destroyed(0);
+    LibManager manager;
+    manager.addLibrary(new TestLib(&manager, oddName, &destroyed),
+                       TestLib::destroy);
+
+    std::string xml;
+    BOOST_REQUIRE(manager.dumpTo(&xml));
+    BOOST_CHECK_EQUAL(xml.compare(0, 12, "  <modules>\n"), 0);
+    BOOST_CHECK(xml.find("<name>a&lt;b&gt;&amp;\"c\"</name>") !=
+                std::string::npos);
+    BOOST_CHECK(xml.find("</modules>") != std::string::npos);
+
+    std::string json;
+    BOOST_REQUIRE(manager.dumpTo(&json, LibManager::LIBMGR_DUMP_JSON));
+    BOOST_CHECK_EQUAL(json.compare(0, 12, "{\"modules\": "), 0);
+    BOOST_CHECK(json.find("{\"name\": \"a<b>&\\\"c\\\"\"") !=
+                std::string::npos);
+    BOOST_CHECK_EQUAL(json.compare(json.size() - 4, 4, "\n]}\n"), 0);
+
+    manager.releaseLibrary(oddName);
+}
+
+BOOST_AUTO_TEST_CASE(binary_dump_lists_every_module)
+{
+    std::atomic<int> destroyed(0);
+    LibManager manager;
+    manager.addLibrary(new TestLib(&manager, "lib_1", &destroyed),
+                       TestLib::destroy);
+    std::string dump;
+    BOOST_REQUIRE(manager.dumpTo(&dump, LibManager::LIBMGR_DUMP_BINARY));
+    BOOST_REQUIRE(dump.size() >= 20);
+    BOOST_CHECK_EQUAL(memcmp(dump.data(), "LMDUMP\0\0", 8), 0);
+    uint32_t header[3];
+    memcpy(header, dump.data() + 8, sizeof(header));
+    BOOST_CHECK_EQUAL(header[0], 0x01020304u);
+    BOOST_CHECK_EQUAL(header[1], 1u);
+    // the library and the C++ standard library
+    BOOST_REQUIRE_EQUAL(header[2], 2u);
+
+    size_t pos = 20;
+    std::vector<std::string> names;
+    for(uint32_t m = 0; m < header[2]; ++m) {
+        BOOST_REQUIRE(pos + 16 <= dump.size());
+        uint32_t lengths[3];
+        memcpy(lengths, dump.data() + pos + 4, sizeof(lengths));
+        pos += 16;
+        BOOST_REQUIRE(pos + lengths[0] + lengths[1] + lengths[2] <=
+                      dump.size());
+        names.push_back(dump.substr(pos, lengths[0]));
+        pos += lengths[0] + lengths[1] + lengths[2];
+    }
+    BOOST_CHECK_EQUAL(pos, dump.size());
+    BOOST_CHECK_EQUAL(names[0], "lib_1");
+    manager.releaseLibrary("lib_1");
+}
+
+BOOST_AUTO_TEST_CASE(file_and_descriptor_dumps_match_the_buffer)
+{
+    TempDir dir;
+    const std::string byName = dir.path() + "/by_name.json";
+    const std::string byFd = dir.path() + "/by_fd.json";
+    LibManager manager;
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    std::string buffer;
+    BOOST_REQUIRE(manager.dumpTo(&buffer, LibManager::LIBMGR_DUMP_JSON));
+    BOOST_REQUIRE(manager.dumpTo(byName, LibManager::LIBMGR_DUMP_JSON));
+    FILE *file = fopen(byFd.c_str(), "w");
+    BOOST_REQUIRE(file);
+    BOOST_CHECK(manager.dumpTo(fileno(file), LibManager::LIBMGR_DUMP_JSON));
+    fclose(file);
+
+    const std::string paths[] = {byName, byFd};
+    for(int i = 0; i < 2; ++i) {
+        std::ifstream in(paths[i].c_str());
+        std::stringstream text;
+        text << in.rdbuf();
+        BOOST_CHECK_EQUAL(text.str(), buffer);
+    }
+    BOOST_CHECK(!manager.dumpTo(dir.path() + "/no/such/dir/dump.xml"));
+    manager.releaseLibrary("test_plain");
+}
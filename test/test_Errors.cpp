@@ -0,0 +1,83 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+using namespace lib_manager;
+
+static const char *missingPath = "/nonexistent/libno_such_plugin.so";
+
+BOOST_AUTO_TEST_CASE(failed_load_is_the_last_error_of_its_thread)
+{
+    LibManager manager;
+    MessageLog messages;
+    manager.setLogSink(&messages);
+    BOOST_CHECK_EQUAL(manager.loadLibrary(missingPath),
+                      LibManager::LIBMGR_ERR_NOT_ABLE_TO_LOAD);
+    LibManager::ErrorInfo error = LibManager::getLastError();
+    BOOST_CHECK_EQUAL(error.error, LibManager::LIBMGR_ERR_NOT_ABLE_TO_LOAD);
+    BOOST_CHECK_EQUAL(error.libPath, missingPath);
+    BOOST_CHECK(!error.detail.empty());
+    BOOST_CHECK(!messages.find(missingPath).empty());
+
+    LibManager::ErrorInfo otherError;
+    otherError.error = LibManager::LIBMGR_ERR_LIB_IN_USE;
+    std::thread other([&otherError]() {
+            otherError = LibManager::getLastError();
+        });
+    other.join();
+    BOOST_CHECK_EQUAL(otherError.error, LibManager::LIBMGR_NO_ERROR);
+
+    BOOST_CHECK(!manager.acquireLibrary("no_such_lib"));
+    error = LibManager::getLastError();
+    BOOST_CHECK_EQUAL(error.error, LibManager::LIBMGR_ERR_NO_LIBRARY);
+    BOOST_CHECK_EQUAL(error.libPath, "no_such_lib");
+    manager.setLogSink(NULL);
+}
+
+BOOST_AUTO_TEST_CASE(log_sink_receives_messages_up_to_the_level)
+{
+    LibManager manager;
+    BOOST_CHECK_EQUAL(manager.getLogLevel(), LibManager::LIBMGR_LOG_INFO);
+    MessageLog messages;
+    manager.setLogSink(&messages);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    std::vector<std::string> loads = messages.find("load plugin");
+    BOOST_REQUIRE_EQUAL(loads.size(), 1u);
+    BOOST_CHECK(loads[0].find(pluginPath("test_plain")) != std::string::npos);
+    // without the trailing newline
+    BOOST_CHECK(loads[0][loads[0].size() - 1] != '\n');
+
+    MessageLog warnings;
+    manager.setLogSink(&warnings);
+    manager.setLogLevel(LibManager::LIBMGR_LOG_WARNING);
+    BOOST_CHECK_EQUAL(manager.getLogLevel(), LibManager::LIBMGR_LOG_WARNING);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_descriptor")),
+                        LibManager::LIBMGR_NO_ERROR);
+    manager.loadLibrary(missingPath);
+    BOOST_CHECK(warnings.find("load plugin").empty());
+    BOOST_CHECK_EQUAL(warnings.maxLevel(), LibManager::LIBMGR_LOG_ERROR);
+
+    manager.releaseLibrary("test_plain");
+    manager.releaseLibrary("test_descriptor");
+    manager.setLogSink(NULL);
+}
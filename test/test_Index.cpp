@@ -0,0 +1,121 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace lib_manager;
+
+/// The file a name was resolved to by loading it.
+static std::string loadAndResolve(LibManager *manager, const std::string &name)
+{
+    EventLog resolved(LibManager::LIBMGR_EVENT_RESOLVED);
+    manager->addLoadListener(&resolved);
+    BOOST_CHECK_EQUAL(manager->loadLibrary(name),
+                      LibManager::LIBMGR_NO_ERROR);
+    manager->removeLoadListener(&resolved);
+    return resolved.lastFilepath();
+}
+
+BOOST_AUTO_TEST_CASE(index_is_not_used_with_another_search_path)
+{
+    SearchPath searchPath;
+    // a second copy of the plugin in another directory
+    char otherDir[] = "/tmp/lib_manager_test_XXXXXX";
+    BOOST_REQUIRE(mkdtemp(otherDir));
+    const std::string copy = copyPlugin("test_plain", otherDir);
+    const std::string indexFile = std::string(otherDir) + "/index";
+
+    searchPath.set(LIB_MANAGER_TEST_PLUGIN_DIR);
+    {
+        LibManager manager;
+        BOOST_CHECK_EQUAL(loadAndResolve(&manager, "test_plain"),
+                          pluginPath("test_plain"));
+        BOOST_REQUIRE(manager.writeIndex(indexFile));
+    }
+    {
+        // same search path: the recorded file is used
+        LibManager manager;
+        BOOST_REQUIRE(manager.readIndex(indexFile));
+        BOOST_CHECK_EQUAL(loadAndResolve(&manager, "test_plain"),
+                          pluginPath("test_plain"));
+    }
+    searchPath.set(otherDir);
+    {
+        LibManager manager;
+        BOOST_REQUIRE(manager.readIndex(indexFile));
+        BOOST_CHECK_EQUAL(loadAndResolve(&manager, "test_plain"), copy);
+        // rewriting keeps only what was resolved with this search path
+        BOOST_REQUIRE(manager.writeIndex(indexFile));
+    }
+    {
+        LibManager manager;
+        BOOST_REQUIRE(manager.readIndex(indexFile));
+        BOOST_CHECK_EQUAL(loadAndResolve(&manager, "test_plain"), copy);
+    }
+
+    remove(indexFile.c_str());
+    remove(copy.c_str());
+    rmdir(otherDir);
+}
+
+BOOST_AUTO_TEST_CASE(file_rewritten_within_a_second_is_not_taken_from_the_index)
+{
+    TempDir dir;
+    const std::string copy = copyPlugin("test_descriptor", dir.path());
+    LibManager manager;
+    // the probe maps the file in a child only; this process must not have
+    // it mapped while it is written over
+    std::vector<std::string> libPaths(1, copy);
+    BOOST_REQUIRE_EQUAL(manager.probeLibraries(libPaths), 1u);
+    // written in place like a rebuild: same inode and size
+    copyPlugin("test_descriptor", dir.path());
+
+    EventLog mapped(LibManager::LIBMGR_EVENT_MAPPED);
+    manager.addLoadListener(&mapped);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(copy, NULL, NULL,
+                                            LibManager::LIBMGR_LOAD_LAZY),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK_EQUAL(mapped.count("test_descriptor"), 1);
+    manager.removeLoadListener(&mapped);
+}
+
+BOOST_AUTO_TEST_CASE(index_entry_is_shadowed_by_an_earlier_search_dir)
+{
+    SearchPath searchPath;
+    TempDir first, second;
+    const std::string indexFile = second.path() + "/index";
+    const std::string old = copyPlugin("test_plain", second.path());
+    searchPath.set(first.path() + ":" + second.path());
+    {
+        LibManager manager;
+        BOOST_CHECK_EQUAL(loadAndResolve(&manager, "test_plain"), old);
+        BOOST_REQUIRE(manager.writeIndex(indexFile));
+    }
+    const std::string shadowing = copyPlugin("test_plain", first.path());
+
+    LibManager manager;
+    BOOST_REQUIRE(manager.readIndex(indexFile));
+    BOOST_CHECK_EQUAL(loadAndResolve(&manager, "test_plain"), shadowing);
+}
@@ -0,0 +1,142 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <cstdio>
+
+using namespace lib_manager;
+
+BOOST_AUTO_TEST_CASE(lazy_plugin_is_constructed_on_first_acquire)
+{
+    LibManager manager;
+    EventLog registered(LibManager::LIBMGR_EVENT_REGISTERED);
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    manager.addLoadListener(&registered);
+    manager.addLoadListener(&constructed);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain"), NULL,
+                                            NULL, LibManager::LIBMGR_LOAD_LAZY),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK_EQUAL(registered.count("test_plain"), 1);
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 0);
+    BOOST_CHECK(manager.getLibraryId("test_plain").isValid());
+
+    LibInterface *lib = manager.acquireLibrary("test_plain");
+    BOOST_REQUIRE(lib);
+    BOOST_CHECK_EQUAL(lib->getLibName(), "test_plain");
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 1);
+    BOOST_CHECK(manager.acquireLibrary("test_plain") == lib);
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 1);
+    manager.releaseLibrary("test_plain");
+    manager.releaseLibrary("test_plain");
+    manager.removeLoadListener(&registered);
+    manager.removeLoadListener(&constructed);
+}
+
+BOOST_AUTO_TEST_CASE(lazy_descriptor_plugin_stays_pending)
+{
+    LibManager manager;
+    EventLog registered(LibManager::LIBMGR_EVENT_REGISTERED);
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    manager.addLoadListener(&registered);
+    manager.addLoadListener(&constructed);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_descriptor"),
+                                            NULL, NULL,
+                                            LibManager::LIBMGR_LOAD_LAZY),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK_EQUAL(registered.count("test_descriptor"), 1);
+    BOOST_CHECK_EQUAL(constructed.count("test_descriptor"), 0);
+
+    BOOST_REQUIRE(manager.acquireLibrary("test_descriptor"));
+    BOOST_CHECK_EQUAL(constructed.count("test_descriptor"), 1);
+    manager.releaseLibrary("test_descriptor");
+    manager.removeLoadListener(&registered);
+    manager.removeLoadListener(&constructed);
+}
+
+BOOST_AUTO_TEST_CASE(indexed_descriptor_plugin_is_deferred_without_mapping)
+{
+    const std::string indexFile = "test_descriptor.index";
+    {
+        LibManager manager;
+        BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_descriptor"),
+                                                NULL, NULL,
+                                                LibManager::LIBMGR_LOAD_LAZY),
+                            LibManager::LIBMGR_NO_ERROR);
+        BOOST_REQUIRE(manager.writeIndex(indexFile));
+    }
+    LibManager manager;
+    BOOST_REQUIRE(manager.readIndex(indexFile));
+    EventLog mapped(LibManager::LIBMGR_EVENT_MAPPED);
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    manager.addLoadListener(&mapped);
+    manager.addLoadListener(&constructed);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_descriptor"),
+                                            NULL, NULL,
+                                            LibManager::LIBMGR_LOAD_LAZY),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK_EQUAL(mapped.count("test_descriptor"), 0);
+    BOOST_CHECK_EQUAL(constructed.count("test_descriptor"), 0);
+
+    BOOST_REQUIRE(manager.acquireLibrary("test_descriptor"));
+    BOOST_CHECK_EQUAL(constructed.count("test_descriptor"), 1);
+    manager.releaseLibrary("test_descriptor");
+    manager.removeLoadListener(&mapped);
+    manager.removeLoadListener(&constructed);
+    remove(indexFile.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(eager_plugin_is_constructed_while_loading)
+{
+    LibManager manager;
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    manager.addLoadListener(&constructed);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 1);
+    manager.removeLoadListener(&constructed);
+}
+
+BOOST_AUTO_TEST_CASE(all_libraries_skip_pending_plugins_unless_asked)
+{
+    LibManager manager;
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    manager.addLoadListener(&constructed);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain"), NULL,
+                                            NULL, LibManager::LIBMGR_LOAD_LAZY),
+                        LibManager::LIBMGR_NO_ERROR);
+    std::list<std::string> names;
+    manager.getAllLibraryNames(&names);
+    BOOST_CHECK_EQUAL(names.size(), 1u);
+
+    std::list<LibInterface*> libs;
+    manager.getAllLibraries(&libs);
+    BOOST_CHECK(libs.empty());
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 0);
+
+    manager.getAllLibraries(&libs, true);
+    BOOST_REQUIRE_EQUAL(libs.size(), 1u);
+    BOOST_CHECK_EQUAL(libs.front()->getLibName(), "test_plain");
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 1);
+    manager.releaseLibrary("test_plain");
+    manager.releaseLibrary("test_plain");
+    manager.removeLoadListener(&constructed);
+}
@@ -0,0 +1,96 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+using namespace lib_manager;
+
+BOOST_AUTO_TEST_CASE(lib_ptr_releases_its_reference)
+{
+    LibManager manager;
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    {
+        LibPtr<LibInterface> lib =
+            manager.acquireLibraryPtr<LibInterface>("test_plain");
+        BOOST_REQUIRE(lib);
+        BOOST_CHECK_EQUAL(lib->getLibName(), "test_plain");
+        BOOST_CHECK(lib.id() == manager.getLibraryId("test_plain"));
+        BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_plain").references, 2);
+    }
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_plain").references, 1);
+    manager.releaseLibrary("test_plain");
+}
+
+BOOST_AUTO_TEST_CASE(moved_lib_ptr_keeps_one_reference)
+{
+    LibManager manager;
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    LibPtr<LibInterface> first =
+        manager.acquireLibraryPtr<LibInterface>("test_plain");
+    LibPtr<LibInterface> second(std::move(first));
+    BOOST_CHECK(!first);
+    BOOST_CHECK(!first.id().isValid());
+    BOOST_REQUIRE(second);
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_plain").references, 2);
+
+    first = std::move(second);
+    BOOST_CHECK(first && !second);
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_plain").references, 2);
+    first.reset();
+    BOOST_CHECK(!first);
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_plain").references, 1);
+    manager.releaseLibrary("test_plain");
+}
+
+BOOST_AUTO_TEST_CASE(lib_ptr_of_another_type_is_empty)
+{
+    LibManager manager;
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK(!manager.acquireLibraryPtr<DependencyInterface>("test_plain"));
+    BOOST_CHECK(!manager.acquireLibraryPtr<LibInterface>("no_such_lib"));
+    // a failed cast keeps no reference
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_plain").references, 1);
+    manager.releaseLibrary("test_plain");
+}
+
+BOOST_AUTO_TEST_CASE(implementers_are_found_by_type)
+{
+    LibManager manager;
+    std::vector<std::string> libPaths;
+    libPaths.push_back(pluginPath("test_plain"));
+    libPaths.push_back(pluginPath("test_dependent"));
+    manager.loadLibraries(libPaths);
+
+    std::vector<LibPtr<DependencyInterface> > libs =
+        manager.findLibrariesImplementing<DependencyInterface>();
+    BOOST_REQUIRE_EQUAL(libs.size(), 1u);
+    BOOST_CHECK(libs[0].id() == manager.getLibraryId("test_dependent"));
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_dependent").references,
+                      2);
+    libs.clear();
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_dependent").references,
+                      1);
+    manager.releaseLibrary("test_dependent");
+    manager.releaseLibrary("test_plain");
+}
@@ -0,0 +1,90 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <dirent.h>
+
+using namespace lib_manager;
+
+/// Number of threads of this process.
+static int countThreads()
+{
+    int count = 0;
+    DIR *dir = opendir("/proc/self/task");
+    if(!dir) {
+        return -1;
+    }
+    while(struct dirent *entry = readdir(dir)) {
+        if(entry->d_name[0] != '.') {
+            ++count;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+BOOST_AUTO_TEST_CASE(parallel_batch_loads_every_plugin)
+{
+    LibManager manager;
+    manager.setNumLoadThreads(4);
+    std::vector<std::string> libPaths;
+    libPaths.push_back(pluginPath("test_dependent"));
+    libPaths.push_back(pluginPath("test_plain"));
+    libPaths.push_back(pluginPath("test_descriptor"));
+    libPaths.push_back(pluginPath("test_holder_1"));
+    libPaths.push_back(pluginPath("test_holder_2"));
+    manager.loadLibraries(libPaths);
+
+    const char *names[] = {"test_dependent", "test_plain", "test_descriptor",
+                           "test_holder_1", "test_holder_2"};
+    for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        BOOST_CHECK_MESSAGE(manager.getLibraryInfo(names[i]).references >= 1,
+                            names[i]);
+        manager.releaseLibrary(names[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(load_threads_are_kept_between_batches)
+{
+    LibManager manager;
+    const int before = countThreads();
+    BOOST_REQUIRE(before > 0);
+    manager.setNumLoadThreads(4);
+    // the calling thread is the fourth
+    BOOST_CHECK_EQUAL(countThreads(), before + 3);
+
+    std::vector<std::string> libPaths;
+    libPaths.push_back(pluginPath("test_plain"));
+    libPaths.push_back(pluginPath("test_descriptor"));
+    for(int i = 0; i < 3; ++i) {
+        manager.loadLibraries(libPaths);
+        BOOST_CHECK_EQUAL(countThreads(), before + 3);
+        manager.releaseLibrary("test_plain");
+        manager.releaseLibrary("test_descriptor");
+    }
+
+    manager.setNumDestroyThreads(6);
+    BOOST_CHECK_EQUAL(countThreads(), before + 5);
+    manager.setNumDestroyThreads(1);
+    manager.setNumLoadThreads(1);
+    BOOST_CHECK_EQUAL(countThreads(), before);
+}
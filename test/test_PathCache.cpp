@@ -0,0 +1,59 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <sys/stat.h>
+
+using namespace lib_manager;
+
+BOOST_AUTO_TEST_CASE(plugin_installed_after_a_cached_miss_is_found)
+{
+    SearchPath searchPath;
+    TempDir dir;
+    searchPath.set(dir.path());
+    LibManager manager;
+    BOOST_CHECK_NE(manager.loadLibrary("test_plain"),
+                   LibManager::LIBMGR_NO_ERROR);
+    // most likely within the same second as the miss
+    copyPlugin("test_plain", dir.path());
+    BOOST_CHECK_EQUAL(manager.loadLibrary("test_plain"),
+                      LibManager::LIBMGR_NO_ERROR);
+}
+
+BOOST_AUTO_TEST_CASE(relative_path_is_not_answered_from_the_cache)
+{
+    TempDir dir;
+    BOOST_REQUIRE(mkdir((dir.path() + "/sub").c_str(), 0700) == 0);
+    copyPlugin("test_plain", dir.path() + "/sub");
+    char oldDir[4096];
+    BOOST_REQUIRE(getcwd(oldDir, sizeof(oldDir)));
+
+    LibManager manager;
+    // not there relative to this directory; the miss is cached
+    BOOST_CHECK_NE(manager.loadLibrary("sub/libtest_plain.so"),
+                   LibManager::LIBMGR_NO_ERROR);
+    BOOST_REQUIRE(chdir(dir.path().c_str()) == 0);
+    BOOST_CHECK_EQUAL(manager.loadLibrary("sub/libtest_plain.so"),
+                      LibManager::LIBMGR_NO_ERROR);
+    manager.clearLibraries();
+    BOOST_CHECK(chdir(oldDir) == 0);
+}
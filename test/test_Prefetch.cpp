@@ -0,0 +1,95 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace lib_manager;
+
+/// Loads test_plain and test_descriptor in one batch and returns the trace.
+static std::string traceBatch(LibManager *manager, const std::string &dir)
+{
+    const std::string traceFile = dir + "/trace.json";
+    std::vector<std::string> libPaths;
+    libPaths.push_back(pluginPath("test_plain"));
+    libPaths.push_back(pluginPath("test_descriptor"));
+    manager->setTracing(true);
+    manager->loadLibraries(libPaths);
+    BOOST_CHECK(manager->getLibraryId("test_plain").isValid());
+    BOOST_CHECK(manager->getLibraryId("test_descriptor").isValid());
+    BOOST_CHECK(manager->writeTrace(traceFile));
+    std::ifstream in(traceFile.c_str());
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+BOOST_AUTO_TEST_CASE(prefetch_runs_before_the_first_library_is_mapped)
+{
+    TempDir dir;
+    LibManager manager;
+    BOOST_CHECK(!manager.getPrefetch());
+    manager.setPrefetch(true);
+    const std::string trace = traceBatch(&manager, dir.path());
+    const size_t prefetch = trace.find("\"name\":\"prefetch\"");
+    BOOST_REQUIRE(prefetch != std::string::npos);
+    BOOST_CHECK(prefetch < trace.find("\"name\":\"dlopen\""));
+    BOOST_CHECK_EQUAL(trace.find("\"name\":\"prefetch\"", prefetch + 1),
+                      std::string::npos);
+    manager.releaseLibrary("test_plain");
+    manager.releaseLibrary("test_descriptor");
+}
+
+BOOST_AUTO_TEST_CASE(nothing_is_prefetched_by_default)
+{
+    TempDir dir;
+    LibManager manager;
+    const std::string trace = traceBatch(&manager, dir.path());
+    BOOST_CHECK(trace.find("\"name\":\"dlopen\"") != std::string::npos);
+    BOOST_CHECK_EQUAL(trace.find("\"name\":\"prefetch\""), std::string::npos);
+    manager.releaseLibrary("test_plain");
+    manager.releaseLibrary("test_descriptor");
+}
+
+BOOST_AUTO_TEST_CASE(locked_library_is_loaded)
+{
+    TempDir dir;
+    const std::string config = dir.path() + "/plugins.txt";
+    {
+        std::ofstream out(config.c_str());
+        out << pluginPath("test_descriptor") << " locked\n";
+    }
+    LibManager manager;
+    // locking may fail for want of RLIMIT_MEMLOCK; the library is loaded
+    // anyway
+    BOOST_CHECK_EQUAL(manager.loadLibrary(pluginPath("test_plain"), NULL,
+                                          NULL, LibManager::LIBMGR_LOAD_LOCKED),
+                      LibManager::LIBMGR_NO_ERROR);
+    manager.loadConfigFile(config);
+    BOOST_CHECK(manager.acquireLibrary("test_plain"));
+    BOOST_CHECK(manager.acquireLibrary("test_descriptor"));
+    manager.releaseLibrary("test_plain");
+    manager.releaseLibrary("test_descriptor");
+    manager.releaseLibrary("test_plain");
+    manager.releaseLibrary("test_descriptor");
+}
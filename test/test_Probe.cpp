@@ -0,0 +1,58 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <cstdlib>
+
+using namespace lib_manager;
+
+BOOST_AUTO_TEST_CASE(timed_out_probe_does_not_reject_the_library)
+{
+    LibManager manager;
+    std::vector<std::string> libPaths(1, pluginPath("test_plain"));
+    std::vector<std::string> rejected;
+    setenv("TEST_PLUGIN_HANG", "1", 1);
+    size_t passed = manager.probeLibraries(libPaths, 1, 200, &rejected);
+    unsetenv("TEST_PLUGIN_HANG");
+    BOOST_CHECK_EQUAL(passed, 0u);
+    BOOST_CHECK_EQUAL(rejected.size(), 1u);
+
+    BOOST_CHECK_EQUAL(manager.loadLibrary(libPaths[0]),
+                      LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK(manager.getLibraryId("test_plain").isValid());
+}
+
+BOOST_AUTO_TEST_CASE(nothing_is_probed_while_manager_threads_run)
+{
+    LibManager manager;
+    std::vector<std::string> libPaths(1, pluginPath("test_plain"));
+    manager.setReclaimMode(LibManager::LIBMGR_RECLAIM_BACKGROUND);
+    std::vector<std::string> rejected;
+    BOOST_CHECK_EQUAL(manager.probeLibraries(libPaths, 1, 5000, &rejected),
+                      0u);
+    BOOST_CHECK_EQUAL(rejected.size(), 1u);
+
+    manager.setReclaimMode(LibManager::LIBMGR_RECLAIM_IMMEDIATE);
+    BOOST_CHECK_EQUAL(manager.probeLibraries(libPaths, 1, 5000), 1u);
+    BOOST_CHECK_EQUAL(manager.loadLibrary(libPaths[0]),
+                      LibManager::LIBMGR_NO_ERROR);
+}
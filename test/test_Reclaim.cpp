@@ -0,0 +1,176 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace lib_manager;
+
+/**
+ * Adds dep_1 and dep_2 and two libraries holding them, then drops the
+ * loader references of dep_1 and dep_2, so that the holders keep them.
+ */
+static void addHolders(LibManager *manager, std::atomic<int> *destroyed)
+{
+    const char *deps[] = {"dep_1", "dep_2"};
+    const char *holders[] = {"holder_1", "holder_2"};
+    for(int i = 0; i < 2; ++i) {
+        BOOST_REQUIRE_EQUAL(manager->addLibrary(new TestLib(manager, deps[i],
+                                                            destroyed),
+                                                TestLib::destroy),
+                            LibManager::LIBMGR_NO_ERROR);
+        BOOST_REQUIRE_EQUAL(manager->addLibrary(new TestLib(manager, holders[i],
+                                                            destroyed, deps[i]),
+                                                TestLib::destroy),
+                            LibManager::LIBMGR_NO_ERROR);
+    }
+    manager->releaseLibrary("dep_1");
+    manager->releaseLibrary("dep_2");
+}
+
+/// A TestLib that notes the thread it is destroyed on.
+class ThreadLib : public TestLib {
+public:
+    ThreadLib(LibManager *theManager, const std::string &name,
+              std::atomic<int> *destroyed,
+              std::vector<std::thread::id> *threads, std::mutex *threadsMutex)
+        : TestLib(theManager, name, destroyed), threads(threads),
+          threadsMutex(threadsMutex) {}
+
+    ~ThreadLib()
+    {
+        std::lock_guard<std::mutex> lock(*threadsMutex);
+        threads->push_back(std::this_thread::get_id());
+    }
+
+private:
+    std::vector<std::thread::id> *threads;
+    std::mutex *threadsMutex;
+};
+
+BOOST_AUTO_TEST_CASE(destroy_functions_run_on_the_calling_thread_by_default)
+{
+    std::atomic<int> destroyed(0);
+    std::vector<std::thread::id> threads;
+    std::mutex threadsMutex;
+    {
+        LibManager manager;
+        manager.setNumLoadThreads(4);
+        // released libraries pile up and are then destroyed in one pass
+        manager.setReclaimMode(LibManager::LIBMGR_RECLAIM_DEFERRED);
+        for(int i = 0; i < 16; ++i) {
+            std::string name = "lib_" + std::to_string(i);
+            manager.addLibrary(new ThreadLib(&manager, name, &destroyed,
+                                             &threads, &threadsMutex),
+                               TestLib::destroy);
+            manager.releaseLibrary(name);
+        }
+        manager.clearLibraries();
+    }
+    BOOST_CHECK_EQUAL(destroyed, 16);
+    BOOST_REQUIRE_EQUAL(threads.size(), 16u);
+    for(size_t i = 0; i < threads.size(); ++i) {
+        BOOST_CHECK(threads[i] == std::this_thread::get_id());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_sweep_unloads_what_destroy_functions_release)
+{
+    std::atomic<int> destroyed(0);
+    LibManager manager;
+    manager.setNumDestroyThreads(4);
+    addHolders(&manager, &destroyed);
+
+    const std::string names[] = {"holder_1", "holder_2"};
+    BOOST_CHECK_EQUAL(manager.releaseLibraries(names, 2), 2u);
+    BOOST_CHECK_EQUAL(destroyed, 4);
+    BOOST_CHECK(!manager.getLibraryId("dep_1").isValid());
+    BOOST_CHECK(!manager.getLibraryId("dep_2").isValid());
+}
+
+BOOST_AUTO_TEST_CASE(clear_libraries_reports_cascaded_destruction)
+{
+    std::atomic<int> destroyed(0);
+    LibManager manager;
+    manager.setNumDestroyThreads(4);
+    addHolders(&manager, &destroyed);
+    manager.setReclaimMode(LibManager::LIBMGR_RECLAIM_DEFERRED);
+    manager.releaseLibrary("holder_1");
+    manager.releaseLibrary("holder_2");
+    BOOST_CHECK_EQUAL(destroyed, 0);
+
+    ClearReport report;
+    manager.clearLibraries(&report);
+    BOOST_CHECK_EQUAL(destroyed, 4);
+    BOOST_CHECK_EQUAL(report.destroyed.size(), 4u);
+    BOOST_CHECK(report.leaked.empty());
+}
+
+BOOST_AUTO_TEST_CASE(deferred_reclaim_waits_for_reclaim_libraries)
+{
+    std::atomic<int> destroyed(0);
+    LibManager manager;
+    manager.addLibrary(new TestLib(&manager, "lib", &destroyed),
+                       TestLib::destroy);
+    manager.setReclaimMode(LibManager::LIBMGR_RECLAIM_DEFERRED);
+    BOOST_CHECK_EQUAL(manager.releaseLibrary("lib"),
+                      LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK_EQUAL(destroyed, 0);
+    // queued libraries cannot be acquired again
+    BOOST_CHECK(!manager.acquireLibrary("lib"));
+    BOOST_CHECK_EQUAL(manager.reclaimLibraries(), 1u);
+    BOOST_CHECK_EQUAL(destroyed, 1);
+    BOOST_CHECK(!manager.getLibraryId("lib").isValid());
+}
+
+BOOST_AUTO_TEST_CASE(dropping_a_snapshot_honours_the_reclaim_mode)
+{
+    std::atomic<int> destroyed(0);
+    LibManager manager;
+    manager.addLibrary(new TestLib(&manager, "lib", &destroyed),
+                       TestLib::destroy);
+    manager.setReclaimMode(LibManager::LIBMGR_RECLAIM_DEFERRED);
+    {
+        LibSnapshot snapshot = manager.snapshotLibraries();
+        BOOST_CHECK_EQUAL(snapshot.size(), 1u);
+        manager.releaseLibrary("lib");
+    }
+    BOOST_CHECK_EQUAL(destroyed, 0);
+    BOOST_CHECK_EQUAL(manager.reclaimLibraries(), 1u);
+    BOOST_CHECK_EQUAL(destroyed, 1);
+}
+
+BOOST_AUTO_TEST_CASE(background_reclaim_destroys_on_its_own)
+{
+    std::atomic<int> destroyed(0);
+    LibManager manager;
+    manager.setReclaimMode(LibManager::LIBMGR_RECLAIM_BACKGROUND);
+    addHolders(&manager, &destroyed);
+    manager.releaseLibrary("holder_1");
+    manager.releaseLibrary("holder_2");
+    for(int i = 0; i < 500 && destroyed < 4; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    BOOST_CHECK_EQUAL(destroyed, 4);
+}
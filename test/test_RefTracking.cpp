@@ -0,0 +1,63 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+using namespace lib_manager;
+
+/**
+ * Holds one tracked reference tagged "holder" and releases the one of the
+ * loader, which was never recorded.
+ */
+static void checkLoaderRelease(LibManager *manager)
+{
+    LibManager::setAcquireTag("holder");
+    BOOST_REQUIRE(manager->acquireLibrary("test_plain"));
+    LibManager::setAcquireTag(NULL);
+    manager->releaseLibrary("test_plain");
+
+    LibTelemetry telemetry;
+    BOOST_REQUIRE(manager->getLibraryTelemetry("test_plain", &telemetry));
+    BOOST_REQUIRE_EQUAL(telemetry.holders.size(), 1u);
+    BOOST_CHECK_EQUAL(telemetry.holders[0].tag, "holder");
+    manager->releaseLibrary("test_plain");
+}
+
+BOOST_AUTO_TEST_CASE(loader_release_keeps_tracked_holders)
+{
+    LibManager manager;
+    manager.setRefTracking(true);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    checkLoaderRelease(&manager);
+}
+
+BOOST_AUTO_TEST_CASE(untracked_references_are_released_first)
+{
+    LibManager manager;
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    // taken before tracking, released after
+    BOOST_REQUIRE(manager.acquireLibrary("test_plain"));
+    manager.setRefTracking(true);
+    checkLoaderRelease(&manager);
+    manager.releaseLibrary("test_plain");
+}
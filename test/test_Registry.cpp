@@ -0,0 +1,74 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <sstream>
+#include <unistd.h>
+
+using namespace lib_manager;
+
+/// A registry name no other test run uses.
+static std::string registryName()
+{
+    std::ostringstream name;
+    name << "/lib_manager_test_" << getpid();
+    return name.str();
+}
+
+BOOST_AUTO_TEST_CASE(attached_registry_defers_lazy_loads)
+{
+    const std::string name = registryName();
+    {
+        LibManager manager;
+        BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_descriptor"),
+                                                NULL, NULL,
+                                                LibManager::LIBMGR_LOAD_LAZY),
+                            LibManager::LIBMGR_NO_ERROR);
+        BOOST_REQUIRE(manager.publishRegistry(name));
+    }
+    LibManager manager;
+    BOOST_REQUIRE(manager.attachRegistry(name));
+    EventLog mapped(LibManager::LIBMGR_EVENT_MAPPED);
+    manager.addLoadListener(&mapped);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_descriptor"),
+                                            NULL, NULL,
+                                            LibManager::LIBMGR_LOAD_LAZY),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK_EQUAL(mapped.count("test_descriptor"), 0);
+    BOOST_REQUIRE(manager.acquireLibrary("test_descriptor"));
+    BOOST_CHECK_EQUAL(mapped.count("test_descriptor"), 1);
+    manager.releaseLibrary("test_descriptor");
+    manager.removeLoadListener(&mapped);
+
+    BOOST_CHECK(LibManager::removeRegistry(name));
+    // already attached managers keep their mapping
+    BOOST_CHECK(manager.getLibraryId("test_descriptor").isValid());
+    LibManager other;
+    BOOST_CHECK(!other.attachRegistry(name));
+}
+
+BOOST_AUTO_TEST_CASE(registry_that_was_never_published_is_not_attached)
+{
+    LibManager manager;
+    BOOST_CHECK(!manager.attachRegistry(registryName() + "_missing"));
+    BOOST_CHECK(!LibManager::removeRegistry(registryName() + "_missing"));
+}
@@ -0,0 +1,82 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+using namespace lib_manager;
+
+BOOST_AUTO_TEST_CASE(reload_library_constructs_a_new_instance)
+{
+    LibManager manager;
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    manager.addLoadListener(&constructed);
+    LibId oldId;
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain"), NULL,
+                                            &oldId),
+                        LibManager::LIBMGR_NO_ERROR);
+    LibId newId;
+    BOOST_CHECK_EQUAL(manager.reloadLibrary("test_plain", &newId),
+                      LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK(newId.isValid());
+    BOOST_CHECK(!manager.acquireLibrary(oldId));
+    BOOST_CHECK_EQUAL(constructed.count("test_plain"), 2);
+
+    // a reference besides the one of the loader prevents reloading
+    BOOST_REQUIRE(manager.acquireLibrary(newId));
+    BOOST_CHECK_EQUAL(manager.reloadLibrary("test_plain"),
+                      LibManager::LIBMGR_ERR_LIB_IN_USE);
+    manager.releaseLibrary(newId);
+    manager.removeLoadListener(&constructed);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_reload_unloads_what_destroy_functions_release)
+{
+    std::atomic<int> destroyed(0);
+    LibManager manager;
+    manager.setNumLoadThreads(4);
+    manager.setNumDestroyThreads(4);
+    EventLog constructed(LibManager::LIBMGR_EVENT_CONSTRUCTED);
+    manager.addLoadListener(&constructed);
+    manager.addLibrary(new TestLib(&manager, "dep_1", &destroyed),
+                       TestLib::destroy);
+    manager.addLibrary(new TestLib(&manager, "dep_2", &destroyed),
+                       TestLib::destroy);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_holder_1")),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_holder_2")),
+                        LibManager::LIBMGR_NO_ERROR);
+    manager.releaseLibrary("dep_1");
+    manager.releaseLibrary("dep_2");
+
+    std::vector<std::string> names;
+    names.push_back("test_holder_1");
+    names.push_back("test_holder_2");
+    BOOST_CHECK_EQUAL(manager.reloadLibraries(names),
+                      LibManager::LIBMGR_NO_ERROR);
+    // the old instances released the last references of their dependencies
+    BOOST_CHECK_EQUAL(destroyed, 2);
+    BOOST_CHECK(!manager.getLibraryId("dep_1").isValid());
+    BOOST_CHECK(manager.getLibraryId("test_holder_1").isValid());
+    BOOST_CHECK(manager.getLibraryId("test_holder_2").isValid());
+    BOOST_CHECK_EQUAL(constructed.count("test_holder_1"), 2);
+    BOOST_CHECK_EQUAL(constructed.count("test_holder_2"), 2);
+    manager.removeLoadListener(&constructed);
+}
@@ -0,0 +1,93 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+using namespace lib_manager;
+
+namespace {
+
+    /// Counts the instances of StaticPlugin.
+    std::atomic<int> numInstances(0);
+
+    class StaticPlugin : public LibInterface {
+    public:
+        StaticPlugin(LibManager *theManager) : LibInterface(theManager)
+        { ++numInstances; }
+        ~StaticPlugin()
+        { --numInstances; }
+
+        int getLibVersion() const
+        { return 3; }
+        const std::string getLibName() const
+        { return "test_static"; }
+
+        CREATE_MODULE_INFO();
+    };
+
+}
+
+CREATE_STATIC_LIB(StaticPlugin, "test_static")
+
+BOOST_AUTO_TEST_CASE(static_lib_is_loaded_without_a_file)
+{
+    LibManager manager;
+    MessageLog messages;
+    manager.setLogSink(&messages);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary("test_static"),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK_EQUAL(numInstances, 1);
+    BOOST_CHECK(messages.find("load plugin").empty());
+    LibInterface *lib = manager.acquireLibrary("test_static");
+    BOOST_REQUIRE(lib);
+    BOOST_CHECK_EQUAL(lib->getLibVersion(), 3);
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_static").version, 3);
+
+    manager.releaseLibrary("test_static");
+    manager.releaseLibrary("test_static");
+    BOOST_CHECK_EQUAL(numInstances, 0);
+    manager.setLogSink(NULL);
+}
+
+BOOST_AUTO_TEST_CASE(lazy_static_lib_is_constructed_on_first_acquire)
+{
+    LibManager manager;
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary("test_static", NULL, NULL,
+                                            LibManager::LIBMGR_LOAD_LAZY),
+                        LibManager::LIBMGR_NO_ERROR);
+    BOOST_CHECK(manager.getLibraryId("test_static").isValid());
+    BOOST_CHECK_EQUAL(numInstances, 0);
+    BOOST_REQUIRE(manager.acquireLibrary("test_static"));
+    BOOST_CHECK_EQUAL(numInstances, 1);
+    manager.releaseLibrary("test_static");
+    manager.releaseLibrary("test_static");
+    BOOST_CHECK_EQUAL(numInstances, 0);
+}
+
+BOOST_AUTO_TEST_CASE(static_lib_cannot_take_a_configuration)
+{
+    LibManager manager;
+    int config = 0;
+    BOOST_CHECK_EQUAL(manager.loadLibrary("test_static", &config),
+                      LibManager::LIBMGR_ERR_NOT_ABLE_TO_LOAD);
+    BOOST_CHECK(!manager.getLibraryId("test_static").isValid());
+    BOOST_CHECK_EQUAL(numInstances, 0);
+}
@@ -0,0 +1,94 @@
+/*
+ *  Copyright 2011, 2012, DFKI GmbH Robotics Innovation Center
+ *
+ *  This file is part of the MARS simulation framework.
+ *
+ *  MARS is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation, either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  MARS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public License
+ *   along with MARS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "TestHelpers.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace lib_manager;
+
+BOOST_AUTO_TEST_CASE(stats_count_uses_and_survive_unloading)
+{
+    LibManager manager;
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    LibStats before = manager.getLibraryStats("test_plain");
+    BOOST_CHECK(before.mapTime > 0);
+    BOOST_CHECK(before.createTime > 0);
+    for(int i = 0; i < 3; ++i) {
+        BOOST_REQUIRE(manager.acquireLibrary("test_plain"));
+        manager.releaseLibrary("test_plain");
+    }
+    LibStats after = manager.getLibraryStats("test_plain");
+    BOOST_CHECK_EQUAL(after.acquires - before.acquires, 3u);
+    BOOST_CHECK_EQUAL(after.releases - before.releases, 3u);
+    BOOST_CHECK_EQUAL(manager.getLibraryInfo("test_plain").stats.acquires,
+                      after.acquires);
+
+    manager.releaseLibrary("test_plain");
+    BOOST_REQUIRE(!manager.getLibraryId("test_plain").isValid());
+    LibStats unloaded = manager.getLibraryStats("test_plain");
+    BOOST_CHECK_EQUAL(unloaded.acquires, after.acquires);
+    BOOST_CHECK_EQUAL(unloaded.releases, after.releases + 1);
+    BOOST_CHECK_EQUAL(unloaded.mapTime, after.mapTime);
+    BOOST_CHECK(unloaded.destroyTime > 0);
+
+    LibStats unknown = manager.getLibraryStats("no_such_lib");
+    BOOST_CHECK_EQUAL(unknown.acquires, 0u);
+    BOOST_CHECK_EQUAL(unknown.mapTime, 0);
+}
+
+BOOST_AUTO_TEST_CASE(trace_records_the_load_steps_while_enabled)
+{
+    TempDir dir;
+    const std::string traceFile = dir.path() + "/trace.json";
+    LibManager manager;
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_descriptor")),
+                        LibManager::LIBMGR_NO_ERROR);
+    manager.setTracing(true);
+    BOOST_REQUIRE_EQUAL(manager.loadLibrary(pluginPath("test_plain")),
+                        LibManager::LIBMGR_NO_ERROR);
+    manager.releaseLibrary("test_plain");
+    BOOST_REQUIRE(manager.writeTrace(traceFile));
+
+    std::ifstream in(traceFile.c_str());
+    std::stringstream text;
+    text << in.rdbuf();
+    const std::string trace = text.str();
+    BOOST_CHECK_EQUAL(trace.compare(0, 15, "{\"traceEvents\":"), 0);
+    const char *steps[] = {"resolve", "dlopen", "symbols", "create",
+                           "destroy"};
+    for(size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); ++i) {
+        BOOST_CHECK_MESSAGE(trace.find(std::string("\"name\":\"") + steps[i] +
+                                       "\"") != std::string::npos, steps[i]);
+    }
+    // loaded before tracing was turned on
+    BOOST_CHECK(trace.find("test_descriptor") == std::string::npos);
+
+    manager.clearTrace();
+    BOOST_REQUIRE(manager.writeTrace(traceFile));
+    std::ifstream cleared(traceFile.c_str());
+    std::stringstream clearedText;
+    clearedText << cleared.rdbuf();
+    BOOST_CHECK(clearedText.str().find("\"name\"") == std::string::npos);
+    manager.releaseLibrary("test_descriptor");
+}